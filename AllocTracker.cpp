@@ -0,0 +1,58 @@
+/*
+ * This is AllocTracker.cpp
+ */
+
+#include "WordClock.h"          // ALLOC_TRACK switch
+#include <new>
+
+static TaskHandle_t trackedTask = NULL;
+static volatile uint32_t allocations = 0;
+
+// start counting allocations made by the calling task (i.e. loop())
+void AllocTracker::begin() {
+  allocations = 0;
+  trackedTask = xTaskGetCurrentTaskHandle();
+};
+
+uint32_t AllocTracker::count() {
+  return allocations;
+};
+
+#ifdef ALLOC_TRACK
+
+static void *_countedAlloc(size_t size) {
+  if (trackedTask != NULL && xTaskGetCurrentTaskHandle() == trackedTask) {
+    allocations++;
+  };
+  return malloc(size ? size : 1);
+}
+
+void *operator new(size_t size) {
+  void *p = _countedAlloc(size);
+  if (p == NULL) {
+    abort();  // out of memory on a clock, nothing sensible left to do
+  };
+  return p;
+}
+
+void *operator new[](size_t size) {
+  return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+  return _countedAlloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+  return _countedAlloc(size);
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete[](void *p) noexcept {
+  free(p);
+}
+
+#endif  // ALLOC_TRACK
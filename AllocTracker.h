@@ -0,0 +1,27 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+/* Heap allocation counter (#define ALLOC_TRACK in WordClock.h).
+ *
+ * The clock runs for months; every malloc/free pair in the steady state is a chance
+ * to fragment the heap. After begin() the render and timekeeping paths are meant to
+ * use flash constants, class members and stack buffers only. To keep it that way the
+ * global operator new is replaced by a counting one, and loop() compares the count
+ * before and after its once a second part (_tick()). Anything non-zero is reported on
+ * the Serial port and lights the warning symbol.
+ *
+ * Only allocations made by the task that called begin() are counted: WiFi, lwIP and
+ * the OTA/sync tasks on core 0 allocate all the time and that's their business.
+ * Plain C malloc() (Arduino String, newlib) can't be hooked from a sketch, which is
+ * why the render path doesn't use String or ctime() at all.
+ */
+
+#include <Arduino.h>
+
+class AllocTracker {
+public:
+  static void begin();
+  static uint32_t count();
+};
+
+#endif
@@ -0,0 +1,193 @@
+/*
+ * This is AmbientLight.cpp
+ */
+
+#include "WordClock.h"          // AMBIENT_LIGHT switch, sensor and curve
+#ifdef AMBIENT_LIGHT
+#if LIGHT_SENSOR == LIGHT_BH1750 && !defined(TIME_WARP)
+#include <Wire.h>
+#endif
+
+const AmbientLight::Point AmbientLight::_curve[] = { LIGHT_CURVE };
+#define LIGHT_CURVE_LEN (sizeof(_curve) / sizeof(_curve[0]))
+
+#ifdef TIME_WARP
+#include "AmbientLightTrace.h"  // a day of readings, tools/light_trace.py makes one
+#define LIGHT_TRACE_LEN (sizeof(lightTrace) / sizeof(lightTrace[0]))
+static_assert(LIGHT_TRACE_LEN * LIGHT_TRACE_STEP == 86400, "the light trace must cover one day");
+#endif
+
+AmbientLight::AmbientLight() {
+  _task = NULL;
+  memset(_window, 0, sizeof(_window));
+  _count = 0;
+  _ema = 0;
+  _reading = 0;
+  _filtered = 0;
+  _target = -1;
+  _level = -1;
+  _changed = false;
+#ifdef TIME_WARP
+  _local = 0;
+#endif
+};
+
+// set up the sensor and start sampling (in TIME_WARP, loop() does the sampling)
+void AmbientLight::begin() {
+#ifndef TIME_WARP
+#if LIGHT_SENSOR == LIGHT_BH1750
+  Wire.begin(LIGHT_SDA, LIGHT_SCL);
+  Wire.beginTransmission(LIGHT_BH1750_ADDR);
+  Wire.write(0x10);  // continuous, 1 lux resolution, 120 ms
+  Wire.endTransmission();
+#else
+  analogReadResolution(12);
+  pinMode(LIGHT_PIN, INPUT);
+#endif
+#ifndef COOPERATIVE
+  xTaskCreatePinnedToCore(_taskMain, "light", LIGHT_TASK_STACK, this, tskIDLE_PRIORITY + 1, &_task, LIGHT_TASK_CORE);
+#endif
+#endif
+};
+
+// share of the brightness 0..255, -1 until the first reading is in
+int AmbientLight::level() {
+  return _level;
+};
+
+// true once after level() has moved
+bool AmbientLight::changed() {
+  if (!_changed) {
+    return false;
+  };
+  _changed = false;
+  return true;
+};
+
+void AmbientLight::stats(Print &out) {
+  out.print("Light: reading ");
+  out.print((long)_reading);
+  out.print(", filtered ");
+  out.print((long)_filtered);
+  out.print(", curve ");
+  out.print(_target);
+  out.print(", level ");
+  out.println(_level);
+};
+
+// "light HH:MM reading", one line of a recording for tools/light_trace.py
+void AmbientLight::trace(Print &out, time_t local) {
+  char buf[32];
+  snprintf(buf, sizeof(buf), "light %02d:%02d %ld", (int)(local % 86400 / 3600), (int)(local % 3600 / 60), (long)_reading);
+  out.println(buf);
+};
+
+#ifdef TIME_WARP
+// one sample off the trace, at this local time
+void AmbientLight::tick(time_t local) {
+  _local = local;
+  _sample();
+};
+#elif defined(COOPERATIVE)
+// one reading, what the task does every LIGHT_PERIOD ms
+void AmbientLight::poll() {
+  _sample();
+};
+#endif
+
+void AmbientLight::_taskMain(void *arg) {
+  AmbientLight *self = (AmbientLight *)arg;
+  TickType_t wake = xTaskGetTickCount();
+  for (;;) {
+    self->_sample();
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(LIGHT_PERIOD));
+  };
+};
+
+// reading -> median -> EMA -> curve, and move the level if that's a visible step
+void AmbientLight::_sample() {
+  int32_t v = _read();
+  _reading = v;
+  memmove(_window, _window + 1, sizeof(_window) - sizeof(_window[0]));
+  _window[LIGHT_MEDIAN - 1] = v;
+  if (_count < LIGHT_MEDIAN) {
+    _count++;
+  };
+  int32_t m = _median();
+  if (_level < 0) {
+    _ema = m << LIGHT_EMA_SHIFT;  // start where we are, not from 0
+  } else {
+    _ema += m - (_ema >> LIGHT_EMA_SHIFT);
+  };
+  _filtered = _ema >> LIGHT_EMA_SHIFT;
+
+  int target = _map(_filtered);
+  _target = target;
+  int band = _level * LIGHT_STEP / 100;
+  if (band < LIGHT_STEP_MIN) {
+    band = LIGHT_STEP_MIN;
+  };
+  if (_level < 0 || abs(target - _level) > band) {
+    _level = target;
+    _changed = true;
+  };
+};
+
+// one reading in the sensor's units
+int32_t AmbientLight::_read() {
+#ifdef TIME_WARP
+  // straight lines between the trace points, by second of the day
+  uint32_t s = (uint32_t)(_local % 86400);
+  uint32_t i = s / LIGHT_TRACE_STEP;
+  int32_t a = lightTrace[i];
+  int32_t b = lightTrace[(i + 1) % LIGHT_TRACE_LEN];
+  return a + (b - a) * (int32_t)(s % LIGHT_TRACE_STEP) / LIGHT_TRACE_STEP;
+#elif LIGHT_SENSOR == LIGHT_BH1750
+  static int32_t last = 0;  // keep the last one if the bus hiccups
+  if (Wire.requestFrom(LIGHT_BH1750_ADDR, 2) == 2) {
+    uint16_t raw = (Wire.read() << 8) | Wire.read();
+    last = raw * 10 / 12;  // counts / 1.2 = lux
+  };
+  return last;
+#else
+  // oversample: the ESP32 ADC is noisy, the mean of a burst much less so
+  int32_t sum = 0;
+  for (int i = 0; i < LIGHT_OVERSAMPLE; i++) {
+    sum += analogRead(LIGHT_PIN);
+  };
+  return sum / LIGHT_OVERSAMPLE;
+#endif
+};
+
+// median of the window (of what's in it so far), insertion sort on a copy
+int32_t AmbientLight::_median() {
+  int32_t sorted[LIGHT_MEDIAN];
+  int n = _count;
+  for (int i = 0; i < n; i++) {
+    int32_t v = _window[LIGHT_MEDIAN - n + i];
+    int j = i;
+    while (j > 0 && sorted[j - 1] > v) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    };
+    sorted[j] = v;
+  };
+  return sorted[n / 2];
+};
+
+// LIGHT_CURVE, straight lines between the points, flat beyond the ends
+int AmbientLight::_map(int32_t v) {
+  if (v <= _curve[0].reading) {
+    return _curve[0].share;
+  };
+  for (unsigned i = 1; i < LIGHT_CURVE_LEN; i++) {
+    if (v < _curve[i].reading) {
+      const Point &a = _curve[i - 1];
+      const Point &b = _curve[i];
+      return a.share + (b.share - a.share) * (v - a.reading) / (b.reading - a.reading);
+    };
+  };
+  return _curve[LIGHT_CURVE_LEN - 1].share;
+};
+
+#endif  // AMBIENT_LIGHT
@@ -0,0 +1,95 @@
+#ifndef AMBIENT_LIGHT_H
+#define AMBIENT_LIGHT_H
+
+/* Brightness from the room instead of the clock (#define AMBIENT_LIGHT in WordClock.h).
+ *
+ * The cosine over the day in FaceRenderer::level() doesn't know about dark winter
+ * afternoons or the sun on the face at 8am. With a sensor, that curve is replaced:
+ *
+ *   LIGHT_LDR      an LDR divider on an ADC1 pin (ADC2 is taken by WiFi), in counts
+ *   LIGHT_BH1750   a BH1750 on I2C, in lux
+ *
+ * A task on core 0, at the lowest priority above idle, takes a reading every
+ * LIGHT_PERIOD ms (the mean of LIGHT_OVERSAMPLE ADC conversions; the BH1750 averages
+ * over its own 120 ms), runs it through a median of LIGHT_MEDIAN (a lamp switched on
+ * for a second, a shadow walking past) and an EMA, and maps that through LIGHT_CURVE:
+ * { reading, share of the brightness 0..255 } points, straight lines in between.
+ *
+ * level() only moves when the curve has moved more than LIGHT_STEP % away from it
+ * (at least LIGHT_STEP_MIN), so a reading sitting on a boundary doesn't make the face
+ * flicker, and changed() tells loop() once per move, which repaints the face then
+ * and only then: no show() for changes nobody would see.
+ *
+ * With COOPERATIVE there's no task either: poll() takes the reading, loop()'s
+ * scheduler calls it every LIGHT_PERIOD ms.
+ *
+ * In TIME_WARP there's no task and no sensor: tick() takes one sample per loop() from
+ * the light trace in AmbientLightTrace.h, a day of readings by local time of day, so
+ * the filter, curve and repaints go through years of days like everything else.
+ *
+ * Serial 'l' prints the last reading, the filter, the curve and the level, in the
+ * sensor's units. Serial 'L' turns on (and off) a "light HH:MM reading" line every
+ * minute, which is how a trace gets recorded: build without TIME_WARP, type 'L', log
+ * the Serial port for a day or a few (the room as it is, curtains and lamps and all),
+ * then
+ *
+ *   python3 tools/light_trace.py light.log -o AmbientLightTrace.h
+ *
+ * averages the days into the trace and TIME_WARP replays that. The one in the tree is
+ * written by hand (its header says so) until somebody records their room.
+ */
+
+#include <Arduino.h>
+
+#define LIGHT_LDR 0
+#define LIGHT_BH1750 1
+
+#define LIGHT_PERIOD 250            // ms between readings
+#define LIGHT_OVERSAMPLE 16         // ADC conversions per reading
+#define LIGHT_MEDIAN 5              // readings, odd
+#define LIGHT_EMA_SHIFT 3           // EMA weight 1/8 (with LIGHT_PERIOD: ~2 s to settle)
+#define LIGHT_STEP 12               // %, smaller moves aren't worth a repaint
+#define LIGHT_STEP_MIN 2            // levels, at the dark end
+#define LIGHT_BH1750_ADDR 0x23
+#define LIGHT_TASK_STACK 2048
+#define LIGHT_TASK_CORE 0
+
+class AmbientLight {
+public:
+  AmbientLight();
+  void begin();
+  int level();
+  bool changed();
+  void stats(Print &out);
+  void trace(Print &out, time_t local);
+#ifdef TIME_WARP
+  void tick(time_t local);
+#elif defined(COOPERATIVE)
+  void poll();
+#endif
+private:
+  struct Point {
+    int32_t reading;
+    int16_t share;
+  };
+  TaskHandle_t _task;
+  int32_t _window[LIGHT_MEDIAN];    // the last readings, oldest first
+  int _count;
+  int32_t _ema;                     // << LIGHT_EMA_SHIFT
+  volatile int32_t _reading;
+  volatile int32_t _filtered;
+  volatile int _target;
+  volatile int _level;              // -1: no reading yet
+  volatile bool _changed;
+#ifdef TIME_WARP
+  time_t _local;
+#endif
+  static const Point _curve[];
+  static void _taskMain(void *arg);
+  void _sample();
+  int32_t _read();
+  int32_t _median();
+  int _map(int32_t v);
+};
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef AMBIENT_LIGHT_TRACE_H
+#define AMBIENT_LIGHT_TRACE_H
+
+// written by hand, not recorded: a day in the living room in LDR counts, dark,
+// daylight from 6:30, clouds from 11 to 1, dusk, the lights on at 17:30 and off at
+// 23:30. Replace it with a recorded one from tools/light_trace.py, see AmbientLight.h
+
+#define LIGHT_TRACE_STEP 900  // s between points, from midnight local time
+
+static const uint16_t lightTrace[96] = {
+    20,   20,   20,   20,   20,   20,   20,   20,   20,   20,   20,   20,  // 00:00
+    20,   20,   20,   20,   20,   20,   20,   20,   20,   20,   20,   20,  // 03:00
+    20,   20,   40,   90,  160,  260,  380,  520,  680,  820,  900, 1100,  // 06:00
+  1300, 1500, 1700, 1900, 2100, 2200, 2200, 2100, 1200,  700,  600,  650,  // 09:00
+   600,  800, 1400, 1700, 1500, 1400, 1300, 1200, 1100, 1000,  900,  800,  // 12:00
+   700,  600,  500,  400,  300,  220,  160,  110,   70,   50,  700,  700,  // 15:00
+   700,  700,  700,  700,  700,  700,  700,  700,  700,  700,  700,  700,  // 18:00
+   700,  700,  700,  700,  700,  700,  700,  700,  700,  700,   20,   20,  // 21:00
+};
+
+#endif
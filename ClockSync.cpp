@@ -0,0 +1,250 @@
+/*
+ * This is ClockSync.cpp
+ */
+
+#include "WordClock.h"          // ECHO/DEBUG/LAN_SYNC switches
+#ifdef LAN_SYNC
+#include <lwip/sockets.h>
+
+ClockSync::ClockSync(TimeBase &time) : _time(time) {
+  _socket = -1;
+  _node = 0;
+  _leader = 0;
+  _leaderAddr = 0;
+  _leaderHeard = 0;
+  _lastAnnounce = 0;
+  _lastRequest = 0;
+  _nSamples = 0;
+  _offset = 0;
+  _rtt = 0;
+};
+
+// call once WiFi is up, starts the sync task on core 0 (COOPERATIVE: someone calls poll())
+void ClockSync::begin() {
+  // the lower 24 bits of the efuse MAC are the vendor part, use the device part
+  _node = (uint32_t)(ESP.getEfuseMac() >> 16);
+  _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (_socket < 0) {
+    return;
+  };
+  int on = 1;
+  setsockopt(_socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(SYNC_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  struct ip_mreq group;
+  group.imr_multiaddr.s_addr = inet_addr(SYNC_GROUP);
+  group.imr_interface.s_addr = htonl(INADDR_ANY);
+  if (bind(_socket, (struct sockaddr *)&addr, sizeof(addr)) < 0
+      || setsockopt(_socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) < 0) {
+#ifdef ECHO
+    Serial.println("LAN sync: can't join the group");
+#endif
+    close(_socket);
+    _socket = -1;
+    return;
+  };
+#ifndef COOPERATIVE
+  xTaskCreatePinnedToCore(_task, "sync", SYNC_TASK_STACK, this, 2, NULL, SYNC_TASK_CORE);
+#endif
+#ifdef ECHO
+  Serial.print("LAN sync: node ");
+  Serial.println(_node, HEX);
+#endif
+};
+
+// the leader has the lowest node id among the clocks that know the time
+bool ClockSync::isLeader() {
+  return _time.isSet() && (_leader == 0 || _node < _leader);
+};
+
+bool ClockSync::isFollowing() {
+  return !isLeader() && _leader != 0;
+};
+
+// last offset applied to follow the leader, ms
+int32_t ClockSync::offset() {
+  return _offset;
+};
+
+// round trip of that exchange, ms
+int32_t ClockSync::rtt() {
+  return _rtt;
+};
+
+// asleep in select() until there's a packet or something to send
+void ClockSync::_task(void *arg) {
+  ClockSync *self = (ClockSync *)arg;
+  for (;;) {
+    self->_poll(SYNC_ANNOUNCE_INTERVAL);
+  };
+};
+
+#ifdef COOPERATIVE
+// what the task does, once, without waiting; every SYNC_POLL ms (a late answer only
+// costs rtt, and the fastest of SYNC_SAMPLES exchanges wins anyway)
+void ClockSync::poll() {
+  if (_socket >= 0) {
+    _poll(0);
+  };
+};
+#endif
+
+// wait up to wait_ms (or until the next announce or request is due) for packets,
+// take them all, then send whatever is due
+void ClockSync::_poll(uint32_t wait_ms) {
+  uint64_t now_ms = _time.uptime_ms();
+  uint64_t due = _lastAnnounce + SYNC_ANNOUNCE_INTERVAL;
+  if (isFollowing() && _lastRequest + SYNC_REQUEST_INTERVAL < due) {
+    due = _lastRequest + SYNC_REQUEST_INTERVAL;
+  };
+  if (due <= now_ms) {
+    wait_ms = 0;
+  } else if (due - now_ms < wait_ms) {
+    wait_ms = due - now_ms;
+  };
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(_socket, &readable);
+  struct timeval tv;
+  tv.tv_sec = wait_ms / 1000;
+  tv.tv_usec = (wait_ms % 1000) * 1000;
+  if (select(_socket + 1, &readable, NULL, NULL, &tv) > 0) {
+    for (;;) {
+      Packet p;
+      struct sockaddr_in from;
+      socklen_t fromlen = sizeof(from);
+      int len = recvfrom(_socket, &p, sizeof(p), MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen);
+      if (len < 0) {
+        break;
+      };
+      if (len == sizeof(Packet) && p.magic == SYNC_MAGIC && p.node != _node) {
+        _receive(p, from.sin_addr.s_addr);
+      };
+    };
+  };
+  now_ms = _time.uptime_ms();
+
+  // drop a leader we haven't heard from for a while, next announce elects a new one
+  if (_leader != 0 && now_ms - _leaderHeard > SYNC_PEER_TIMEOUT) {
+#ifdef ECHO
+    Serial.println("LAN sync: leader lost");
+#endif
+    _leader = 0;
+    _nSamples = 0;
+  };
+
+  if (now_ms - _lastAnnounce >= SYNC_ANNOUNCE_INTERVAL) {
+    _announce();
+    _lastAnnounce = now_ms;
+  };
+  if (isFollowing() && now_ms - _lastRequest >= SYNC_REQUEST_INTERVAL) {
+    _request();
+    _lastRequest = now_ms;
+  };
+};
+
+void ClockSync::_receive(Packet &p, uint32_t from) {
+  switch (p.type) {
+    case ANNOUNCE:
+      if (p.timeSet && (_leader == 0 || p.node <= _leader)) {
+        if (p.node != _leader) {
+          _nSamples = 0;
+#ifdef ECHO
+          Serial.print("LAN sync: leader is ");
+          Serial.println(p.node, HEX);
+#endif
+        };
+        _leader = p.node;
+        _leaderAddr = from;
+        _leaderHeard = _time.uptime_ms();
+      };
+#ifdef DEBUG
+      if (isLeader()) {
+        Serial.print("LAN sync: peer ");
+        Serial.print(p.node, HEX);
+        Serial.print(" offset ");
+        Serial.print(p.offset);
+        Serial.print(" ms, rtt ");
+        Serial.print(p.rtt);
+        Serial.println(" ms");
+      };
+#endif
+      break;
+    case DELAY_REQ:
+      if (isLeader()) {
+        p.type = DELAY_RESP;
+        p.node = _node;
+        p.t2 = _time.utc_ms();  // receive and send are the same instant for us
+        p.t3 = p.t2;
+        _send(p, from);
+      };
+      break;
+    case DELAY_RESP: {
+      int64_t t4 = _time.utc_ms();
+      int64_t rtt = (t4 - p.t1) - (p.t3 - p.t2);
+      if (p.node == _leader && rtt >= 0 && rtt <= SYNC_MAX_RTT && _nSamples < SYNC_SAMPLES) {
+        _samples[_nSamples].offset = ((p.t2 - p.t1) + (p.t3 - t4)) / 2;
+        _samples[_nSamples].rtt = (int32_t)rtt;
+        _nSamples++;
+        if (_nSamples == SYNC_SAMPLES) {
+          _applyBestSample();
+        };
+      };
+      break;
+    };
+  };
+};
+
+void ClockSync::_send(Packet &p, uint32_t to) {
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(SYNC_PORT);
+  addr.sin_addr.s_addr = to;
+  sendto(_socket, &p, sizeof(p), 0, (struct sockaddr *)&addr, sizeof(addr));
+};
+
+void ClockSync::_announce() {
+  Packet p = {};
+  p.magic = SYNC_MAGIC;
+  p.type = ANNOUNCE;
+  p.timeSet = _time.isSet();
+  p.node = _node;
+  p.offset = _offset;
+  p.rtt = _rtt;
+  p.t1 = _time.utc_ms();
+  _send(p, inet_addr(SYNC_GROUP));
+};
+
+void ClockSync::_request() {
+  Packet p = {};
+  p.magic = SYNC_MAGIC;
+  p.type = DELAY_REQ;
+  p.node = _node;
+  p.t1 = _time.utc_ms();
+  _send(p, _leaderAddr);
+};
+
+// keep the fastest round trip, it has the least asymmetric delay
+void ClockSync::_applyBestSample() {
+  int best = 0;
+  for (int i = 1; i < _nSamples; i++) {
+    if (_samples[i].rtt < _samples[best].rtt) {
+      best = i;
+    };
+  };
+  int64_t offset = _samples[best].offset;
+  if (offset > 1000 || offset < -1000) {
+    _time.set(_time.utc_ms() + offset);  // never synced, or way off: step
+  } else if (offset != 0) {
+    _time.adjust((int32_t)offset);
+  };
+  _offset = (int32_t)(offset > INT32_MAX ? INT32_MAX : offset < INT32_MIN ? INT32_MIN : offset);
+  _rtt = _samples[best].rtt;
+  _nSamples = 0;
+};
+
+#endif  // LAN_SYNC
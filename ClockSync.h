@@ -0,0 +1,104 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+/* LAN sync, so several WordClocks in one room flip their faces together.
+ *
+ * Every clock multicasts an ANNOUNCE every SYNC_ANNOUNCE_INTERVAL ms. The clock with
+ * the lowest node id (taken from the MAC) that has its time set is the leader; it
+ * keeps talking to NTP, the others stop polling NTP and follow the leader instead.
+ *
+ * Followers measure their offset against the leader with a PTP style exchange:
+ *
+ *   follower t1 --DELAY_REQ--> t2 leader
+ *   follower t4 <-DELAY_RESP-- t3 leader
+ *
+ *   offset = ((t2 - t1) + (t3 - t4)) / 2,  rtt = (t4 - t1) - (t3 - t2)
+ *
+ * Out of the last SYNC_SAMPLES exchanges the one with the smallest rtt wins (WiFi
+ * latency is very jittery, the fastest round trip is the least asymmetric one) and
+ * its offset is applied to the TimeBase. The common flip instant is then simply the
+ * minute boundary of the shared time base: WordClock::loop() sleeps until the next
+ * whole second, so all faces change within a few ms of each other.
+ *
+ * One lwIP UDP socket in the multicast group and a fixed packet buffer, no WiFiUDP
+ * (which allocates a buffer per received packet). The task sleeps in select() until
+ * a packet comes in or the next announce or request is due, and stamps the packet
+ * right after it wakes up. With COOPERATIVE, poll() is one round with a select()
+ * that doesn't wait, every SYNC_POLL ms.
+ *
+ * Followers put their current offset and rtt into their ANNOUNCE, so the leader
+ * can print their offsets (DEBUG). That is what the followers think, not when the
+ * faces flip: tools/sync_sim.py runs the same exchange between clocks on loopback,
+ * with drift, WiFi jitter and an asymmetric path, and measures the flip spread.
+ * That is a model, host threads and not WiFi between ESP32s, and the seed doesn't
+ * fix the host's scheduling, so runs differ. With its defaults and --seed 1 over
+ * 600 s: median 3.8 ms, 95% 8.6 ms, worst 13.3 ms; with --asym 10 as well, median
+ * 7.2 ms, worst 30.2 ms. Nobody has put a scope on two real faces yet.
+ */
+
+#include <Arduino.h>
+#include "TimeBase.h"
+
+#define SYNC_GROUP "239.12.12.144"              // multicast group, 12x12=144
+#define SYNC_PORT 14412
+#define SYNC_MAGIC 0x57434C4B                   // "WCLK"
+#define SYNC_ANNOUNCE_INTERVAL 2000             // ms between announcements
+#define SYNC_REQUEST_INTERVAL 500               // ms between delay requests to the leader
+#define SYNC_PEER_TIMEOUT 10000                 // ms without announcements before a leader is dropped
+#define SYNC_SAMPLES 8                          // delay exchanges per offset decision
+#define SYNC_MAX_RTT 100                        // ms, slower exchanges are ignored
+#define SYNC_TASK_STACK 4096
+#define SYNC_TASK_CORE 0
+#define SYNC_POLL 1                             // COOPERATIVE: ms between looks at the socket
+
+class ClockSync {
+public:
+  ClockSync(TimeBase &time);
+  void begin();
+  bool isLeader();
+  bool isFollowing();
+  int32_t offset();
+  int32_t rtt();
+#ifdef COOPERATIVE
+  void poll();
+#endif
+private:
+  enum { ANNOUNCE = 1, DELAY_REQ = 2, DELAY_RESP = 3 };
+  struct Packet {
+    uint32_t magic;
+    uint8_t type;
+    uint8_t timeSet;
+    uint16_t reserved;
+    uint32_t node;
+    int32_t offset;   // ANNOUNCE: sender's last offset to the leader, ms
+    int32_t rtt;      // ANNOUNCE: sender's best rtt to the leader, ms
+    int64_t t1;
+    int64_t t2;
+    int64_t t3;
+  } __attribute__((packed));
+  struct Sample {
+    int64_t offset;
+    int32_t rtt;
+  };
+  TimeBase &_time;
+  int _socket;
+  uint32_t _node;
+  uint32_t _leader;
+  uint32_t _leaderAddr;   // IPv4, network order
+  uint64_t _leaderHeard;
+  uint64_t _lastAnnounce;
+  uint64_t _lastRequest;
+  Sample _samples[SYNC_SAMPLES];
+  int _nSamples;
+  volatile int32_t _offset;
+  volatile int32_t _rtt;
+  static void _task(void *arg);
+  void _poll(uint32_t wait_ms);
+  void _receive(Packet &p, uint32_t from);
+  void _send(Packet &p, uint32_t to);
+  void _announce();
+  void _request();
+  void _applyBestSample();
+};
+
+#endif
@@ -0,0 +1,169 @@
+/*
+ * This is Coop.cpp
+ */
+
+#include "WordClock.h"          // COOPERATIVE switch
+#ifdef COOPERATIVE
+
+#define COOP_IDLE_MAX 1000      // ms run() lets loop() sleep at most, the watchdog wants feeding
+
+CoopScheduler::CoopScheduler() {
+  memset(_tasks, 0, sizeof(_tasks));
+  _pass = 0;
+  _switches = 0;
+  _busyMicros = 0;
+};
+
+// a new task, it runs on the next pass; NULL if all COOP_MAX_TASKS slots are taken
+CoopTask *CoopScheduler::add(const char *name, CoopStep step, void *self) {
+  for (int i = 0; i < COOP_MAX_TASKS; i++) {
+    CoopTask &t = _tasks[i];
+    if (t.name == NULL) {
+      memset(&t, 0, sizeof(t));
+      t.name = name;
+      t.step = step;
+      t.self = self;
+      t.wake = 0;
+      t.pass = _pass;
+      return &t;
+    };
+  };
+  return NULL;
+};
+
+// due right now, whatever it's waiting for (it finds out itself when it runs)
+void CoopScheduler::wake(CoopTask *t) {
+  if (t != NULL) {
+    t->wake = 0;
+  };
+};
+
+// run everything that's due, earliest deadline first, each task once;
+// returns ms until the next deadline
+uint32_t CoopScheduler::run(uint64_t now_ms) {
+  _pass++;
+  uint32_t elapsed_us = 0;
+  for (;;) {
+    uint64_t now = now_ms + elapsed_us / 1000;
+    CoopTask *next = NULL;
+    for (int i = 0; i < COOP_MAX_TASKS; i++) {
+      CoopTask &t = _tasks[i];
+      if (t.name != NULL && t.pass != _pass && t.wake <= now && (next == NULL || t.wake < next->wake)) {
+        next = &t;
+      };
+    };
+    if (next == NULL) {
+      break;
+    };
+    next->pass = _pass;
+    if (next->wake != 0 && now - next->wake > next->worstLate) {
+      next->worstLate = now - next->wake;
+    };
+    next->now = now;
+    unsigned long start = micros();
+    next->step(*next);
+    uint32_t us = micros() - start;
+    elapsed_us += us;
+    next->runs++;
+    if (us > next->worstMicros) {
+      next->worstMicros = us;
+    };
+    _switches++;
+    _busyMicros += us;
+  };
+
+  uint64_t now = now_ms + elapsed_us / 1000;
+  uint64_t soonest = COOP_NEVER;
+  for (int i = 0; i < COOP_MAX_TASKS; i++) {
+    if (_tasks[i].name != NULL && _tasks[i].wake < soonest) {
+      soonest = _tasks[i].wake;
+    };
+  };
+  if (soonest <= now) {
+    return 0;
+  };
+  return soonest - now < COOP_IDLE_MAX ? soonest - now : COOP_IDLE_MAX;
+};
+
+void CoopScheduler::stats(Print &out) {
+  char buf[96];
+  snprintf(buf, sizeof(buf), "Coop: %lu steps, %lu us average",
+           (unsigned long)_switches, (unsigned long)(_switches ? _busyMicros / _switches : 0));
+  out.println(buf);
+  for (int i = 0; i < COOP_MAX_TASKS; i++) {
+    const CoopTask &t = _tasks[i];
+    if (t.name == NULL) {
+      continue;
+    };
+    snprintf(buf, sizeof(buf), "  %-8s %8lu runs, worst step %6lu us, worst late %5lu ms",
+             t.name, (unsigned long)t.runs, (unsigned long)t.worstMicros, (unsigned long)t.worstLate);
+    out.println(buf);
+  };
+};
+
+#ifdef DEBUG
+#define COOP_BENCH_TASKS 4
+#define COOP_BENCH_PASSES 10000
+#define COOP_BENCH_PINGS 1000
+
+// does nothing but count and hand the core on
+static void coopBenchStep(CoopTask &t) {
+  uint32_t *count = (uint32_t *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    (*count)++;
+    COOP_YIELD(t);
+  };
+  COOP_END(t);
+};
+
+// the other side of the FreeRTOS ping-pong: notified, notifies back
+static void coopBenchPong(void *arg) {
+  TaskHandle_t ping = (TaskHandle_t)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    xTaskNotifyGive(ping);
+  };
+};
+
+// what a switch costs: between protothreads, and between FreeRTOS tasks on one core
+void CoopScheduler::benchmark(Print &out) {
+  static CoopScheduler bench;  // a few hundred bytes, not on loop()'s stack
+  static uint32_t counts[COOP_BENCH_TASKS];
+  bench = CoopScheduler();
+  for (int i = 0; i < COOP_BENCH_TASKS; i++) {
+    counts[i] = 0;
+    bench.add("bench", coopBenchStep, &counts[i]);
+  };
+  unsigned long start = micros();
+  for (int p = 0; p < COOP_BENCH_PASSES; p++) {
+    bench.run(0);
+  };
+  unsigned long coop_us = micros() - start;
+  uint32_t switches = 0;
+  for (int i = 0; i < COOP_BENCH_TASKS; i++) {
+    switches += counts[i];
+  };
+
+  TaskHandle_t pong = NULL;
+  xTaskCreatePinnedToCore(coopBenchPong, "pong", 2048, xTaskGetCurrentTaskHandle(),
+                          uxTaskPriorityGet(NULL), &pong, xPortGetCoreID());
+  start = micros();
+  for (int p = 0; p < COOP_BENCH_PINGS; p++) {
+    xTaskNotifyGive(pong);
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  };
+  unsigned long rtos_us = micros() - start;
+  vTaskDelete(pong);
+
+  char buf[96];
+  snprintf(buf, sizeof(buf), "Coop: %lu protothread switches, %.2f us each (scheduler included)",
+           (unsigned long)switches, (double)coop_us / switches);
+  out.println(buf);
+  snprintf(buf, sizeof(buf), "Coop: %d FreeRTOS ping-pongs, %.2f us per task switch",
+           COOP_BENCH_PINGS, (double)rtos_us / (2 * COOP_BENCH_PINGS));
+  out.println(buf);
+};
+#endif  // DEBUG
+
+#endif  // COOPERATIVE
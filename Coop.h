@@ -0,0 +1,106 @@
+#ifndef COOP_H
+#define COOP_H
+
+/* Cooperative tasks on one core (#define COOPERATIVE in WordClock.h).
+ *
+ * loop() assumes a second core for anything that blocks: the SNTP round, OTA and the
+ * rest run in FreeRTOS tasks on core 0, and what's left in loop() (waiting for WiFi,
+ * the chase effect) simply blocks it. A single core part (ESP32-C3, -S2) has nowhere to
+ * put that. With COOPERATIVE, loop() runs a scheduler instead, and the clock's work is
+ * split into tasks that give the core back whenever they'd wait:
+ *
+ *   network   WiFi (waits without blocking), the SNTP round a step at a time
+ *   render    once a second: Serial, the minute flip
+ *   log       WiFi changes into the flight recorder, stats
+ *   effects   the chase, a pixel per 10 ms wakeup
+ *   sync      LAN_SYNC: ClockSync::poll() every SYNC_POLL ms
+ *   light     AMBIENT_LIGHT: a sensor reading every LIGHT_PERIOD ms
+ *   mirror    FACE_MIRROR: a round of its sockets every MIRROR_TICK ms
+ *
+ * Nothing else gets a FreeRTOS task: WordClock.h turns off what can't do without one
+ * (DITHER, OTA_UPDATE, MQTT_STATE).
+ *
+ * No C++20 here (the core is gnu++11), so no coroutines: these are protothreads. A task
+ * is a plain function that is called again and again; COOP_BEGIN switches to the line
+ * it returned from last time, so
+ *
+ *   COOP_BEGIN(t);
+ *   for (;;) {
+ *     ...
+ *     COOP_SLEEP(t, 1000);                  // back here in a second
+ *     COOP_WAIT_UNTIL(t, done(), 20);       // test every 20 ms until it's true
+ *   };
+ *   COOP_END(t);
+ *
+ * reads like a thread but has no stack of its own: a CoopTask is a couple of dozen
+ * bytes. The price is that locals don't survive a COOP_* (keep state in the owner),
+ * at most one COOP_* per source line, and no COOP_* inside a switch of your own.
+ *
+ * Every task has a deadline (uptime ms). run() runs what's due, earliest deadline
+ * first, each task once per pass, and returns how long nothing is due, for loop() to
+ * sleep. It keeps per task the runs, the worst step (us) and the worst lateness past
+ * the deadline (ms): for the render task that is the worst-case delay of the minute
+ * flip. stats() (Serial 'c') prints that; benchmark() (DEBUG, Serial 'k') measures
+ * what a switch between tasks costs.
+ */
+
+#include <Arduino.h>
+
+#define COOP_MAX_TASKS 8
+#define COOP_NEVER UINT64_MAX       // wake: only when someone calls wake()
+// the clock's tasks (WordClock::_coop*)
+#define COOP_NET_POLL 20            // ms between looks for SNTP replies
+#define COOP_LOG_PERIOD 1000        // ms
+#define COOP_CHASE_STEP 10          // ms per pixel, as _demoChase()
+
+struct CoopTask;
+typedef void (*CoopStep)(CoopTask &t);
+
+struct CoopTask {
+  const char *name;                 // NULL: free slot
+  CoopStep step;
+  void *self;                       // the owner, step() casts it back
+  uint16_t line;                    // where to carry on, 0: from the top
+  uint64_t wake;                    // deadline, uptime ms, 0: as soon as possible
+  uint64_t now;                     // when this step started
+  uint64_t since;                   // when the current wait started
+  uint32_t pass;                    // the run() pass it last ran in
+  uint32_t runs;
+  uint32_t worstMicros;
+  uint32_t worstLate;               // ms
+};
+
+#define COOP_BEGIN(t) switch ((t).line) { case 0:
+#define COOP_END(t) } (t).line = 0; (t).name = NULL
+// give the others a go, back on the next pass
+#define COOP_YIELD(t) \
+  do { (t).line = __LINE__; (t).wake = (t).now; return; case __LINE__:; } while (0)
+#define COOP_SLEEP(t, ms) \
+  do { (t).line = __LINE__; (t).wake = (t).now + (ms); return; case __LINE__:; } while (0)
+// until wake() (or for good)
+#define COOP_SUSPEND(t) \
+  do { (t).line = __LINE__; (t).wake = COOP_NEVER; return; case __LINE__:; } while (0)
+// test cond every poll ms; COOP_WAITED(t) is how long it has been, for timeouts
+#define COOP_WAIT_UNTIL(t, cond, poll) \
+  do { (t).since = (t).now; (t).line = __LINE__; case __LINE__: \
+       if (!(cond)) { (t).wake = (t).now + (poll); return; }; } while (0)
+#define COOP_WAITED(t) ((t).now - (t).since)
+
+class CoopScheduler {
+public:
+  CoopScheduler();
+  CoopTask *add(const char *name, CoopStep step, void *self);
+  void wake(CoopTask *t);
+  uint32_t run(uint64_t now_ms);
+  void stats(Print &out);
+#ifdef DEBUG
+  static void benchmark(Print &out);
+#endif
+private:
+  CoopTask _tasks[COOP_MAX_TASKS];
+  uint32_t _pass;
+  uint32_t _switches;
+  uint64_t _busyMicros;
+};
+
+#endif
@@ -0,0 +1,105 @@
+/*
+ * This is Dither.cpp
+ */
+
+#include "WordClock.h"          // DITHER switch, NEO_PIXELS
+#ifdef DITHER
+
+Dither::Dither(uint16_t n, int16_t pin) : _strip(n, pin, NEO_GRB + NEO_KHZ800) {
+  memset(_target, 0, sizeof(_target));
+  memset(_error, 0, sizeof(_error));
+  _handle = NULL;
+  _refreshes = 0;
+  _computeMicros = 0;
+  _showMicros = 0;
+  _rateStart = 0;
+  _rateRefreshes = 0;
+};
+
+void Dither::begin() {
+  _strip.begin();
+  _rateStart = millis();
+  xTaskCreatePinnedToCore(_task, "dither", DITHER_TASK_STACK, this, DITHER_TASK_PRIORITY, &_handle, DITHER_TASK_CORE);
+};
+
+// take over a finished frame from WordClock, in one go so we never show half of one
+void Dither::commit(NeoStrip &pixels) {
+  uint8_t next[NEO_PIXELS * 3];
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    uint32_t c = pixels.getPixelColor(p);
+    next[3 * p] = (uint8_t)(c >> 16);
+    next[3 * p + 1] = (uint8_t)(c >> 8);
+    next[3 * p + 2] = (uint8_t)c;
+  };
+  portENTER_CRITICAL(&_lock);
+  memcpy(_target, next, sizeof(_target));
+  portEXIT_CRITICAL(&_lock);
+  if (_handle != NULL) {
+    xTaskNotifyGive(_handle);
+  };
+};
+
+// refreshes per second since the last call, 0 while nothing needs dithering
+float Dither::refreshRate() {
+  unsigned long now_ms = millis();
+  uint32_t n = _refreshes;
+  float rate = (now_ms > _rateStart) ? 1000.0 * (n - _rateRefreshes) / (now_ms - _rateStart) : 0.0;
+  _rateStart = now_ms;
+  _rateRefreshes = n;
+  return rate;
+};
+
+// time spent on the arithmetic in the last refresh
+uint32_t Dither::computeMicros() {
+  return _computeMicros;
+};
+
+// time spent sending the last refresh to the strip (mostly waiting for the RMT)
+uint32_t Dither::showMicros() {
+  return _showMicros;
+};
+
+void Dither::_task(void *arg) {
+  Dither *self = (Dither *)arg;
+  TickType_t wake = xTaskGetTickCount();
+  const TickType_t period = pdMS_TO_TICKS(1000 / DITHER_HZ);
+  for (;;) {
+    if (self->_refresh()) {
+      vTaskDelayUntil(&wake, period);
+    } else {
+      // all whole levels, what's on the strip stays right: wait for a new frame
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      wake = xTaskGetTickCount();
+    };
+  };
+};
+
+// one refresh; true if some channel has a fractional level, so the next one differs
+bool Dither::_refresh() {
+  unsigned long t0 = micros();
+  uint8_t target[NEO_PIXELS * 3];
+  portENTER_CRITICAL(&_lock);
+  memcpy(target, _target, sizeof(target));
+  portEXIT_CRITICAL(&_lock);
+  bool fractional = false;
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    uint8_t out[3];
+    for (int c = 0; c < 3; c++) {
+      int i = 3 * p + c;
+      // 8.8 target plus what we owe from last time; never overflows 16 bits
+      uint16_t v = gamma16[target[i]] + _error[i];
+      out[c] = v >> 8;
+      _error[i] = v & 0xFF;
+      fractional |= (gamma16[target[i]] & 0xFF) != 0;
+    };
+    _strip.setPixelColor(p, out[0], out[1], out[2]);
+  };
+  unsigned long t1 = micros();
+  _strip.show();
+  _showMicros = micros() - t1;
+  _computeMicros = t1 - t0;
+  _refreshes++;
+  return fractional;
+};
+
+#endif  // DITHER
@@ -0,0 +1,83 @@
+/*
+ * This is FaceBenchmark.cpp
+ */
+
+#include "WordClock.h"          // DEBUG switch, Print, micros()
+#ifdef DEBUG
+#include <thread>
+
+// FaceRenderer itself stays clear of the Arduino core, the timing lives here
+
+#define FACE_BENCH_MINUTES 1440  // a day
+#define FACE_BENCH_FRAMES 48     // frames rendered into at a time, reused
+
+static FaceRenderer::Frame benchFrames[FACE_BENCH_FRAMES];
+static FaceRenderer::Job benchJobs[FACE_BENCH_FRAMES];
+
+static void benchPrint(Print &out, const char *name, unsigned long us, int threads) {
+  float fps = FACE_BENCH_MINUTES * 1000000.0 / us;
+  out.print("FaceRenderer: ");
+  out.print(name);
+  out.print(" ");
+  out.print((float)us / FACE_BENCH_MINUTES);
+  out.print(" us/frame, ");
+  out.print(fps);
+  out.print(" fps, ");
+  out.print(fps / threads);
+  out.println(" fps per core");
+}
+
+// a day of device's face, minute by minute from midnight UTC today
+void FaceRenderer::benchmark(Print &out, const Device &device) {
+  time_t day = previousMidnight(now());
+  int threads = std::thread::hardware_concurrency();
+  if (threads < 1) {
+    threads = 1;
+  };
+  if (threads > FACE_BATCH_THREADS) {
+    threads = FACE_BATCH_THREADS;
+  };
+
+  // the words alone: a few mask ORs
+  FrameMask mask;
+  uint32_t sum = 0;
+  unsigned long start = micros();
+  for (int i = 0; i < FACE_BENCH_MINUTES; i++) {
+    words(i / 60, i % 60, *device.config.phrase, mask);
+    sum += mask.w[0];
+  };
+  benchPrint(out, "words", micros() - start, 1);
+
+  // whole frames, palette, sun and moon, holidays
+  start = micros();
+  for (int i = 0; i < FACE_BENCH_MINUTES; i++) {
+    render(day + 60 * i, device, STATUS_WIFI | STATUS_TIME, benchFrames[i % FACE_BENCH_FRAMES]);
+    sum += benchFrames[i % FACE_BENCH_FRAMES].lit.w[0];
+  };
+  benchPrint(out, "frames", micros() - start, 1);
+
+  // an empty batch starts the workers (once, they stay), so the rate below is theirs
+  start = micros();
+  renderBatch(benchJobs, 0, benchFrames, threads);
+  out.print("FaceRenderer: workers ready in ");
+  out.print(micros() - start);
+  out.println(" us (0 once running)");
+
+  // the same frames, FACE_BENCH_FRAMES at a time over all cores
+  start = micros();
+  for (int i = 0; i < FACE_BENCH_MINUTES; i += FACE_BENCH_FRAMES) {
+    int n = FACE_BENCH_MINUTES - i < FACE_BENCH_FRAMES ? FACE_BENCH_MINUTES - i : FACE_BENCH_FRAMES;
+    for (int j = 0; j < n; j++) {
+      benchJobs[j].utc = day + 60 * (i + j);
+      benchJobs[j].device = &device;
+      benchJobs[j].status = STATUS_WIFI | STATUS_TIME;
+    };
+    renderBatch(benchJobs, n, benchFrames, threads);
+    sum += benchFrames[0].lit.w[0];
+  };
+  benchPrint(out, threads > 1 ? "batch" : "batch (1 core)", micros() - start, threads);
+  out.print("FaceRenderer: checksum ");
+  out.println(sum, HEX);  // keeps the loops honest
+};
+
+#endif  // DEBUG
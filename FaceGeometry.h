@@ -0,0 +1,53 @@
+#ifndef FACE_GEOMETRY_H
+#define FACE_GEOMETRY_H
+
+/* Grid geometry of the clock face and how the LED strip is wired through it.
+ *
+ * The strip starts in one corner (ORIGIN) and runs along the rows or the columns
+ * (WIRING), turning around at the end of each one (serpentine/meander):
+ *
+ *   FaceGeometry<12, 12, FACE_TOP_LEFT, FACE_ALONG_ROWS>
+ *
+ *       col 0 ......... 11
+ *   row 0   0  1  2 ... 11  ->
+ *   row 1  23 22 21 ... 12  <-
+ *   row 2  24 25 26 ... 35  ->
+ *
+ * index(row, col) is constexpr, so words written in (row, col) grid coordinates
+ * compile down to plain strip indices. Used in a constexpr word table, a coordinate
+ * off the grid doesn't compile (it ends up calling the non-constexpr
+ * faceCoordinateOutOfRange()).
+ */
+
+enum FaceOrigin { FACE_TOP_LEFT, FACE_TOP_RIGHT, FACE_BOTTOM_LEFT, FACE_BOTTOM_RIGHT };
+enum FaceWiring { FACE_ALONG_ROWS, FACE_ALONG_COLUMNS };
+
+// deliberately not constexpr, see above; at run time an off-grid pixel is just "no pixel"
+inline int faceCoordinateOutOfRange() {
+  return -1;
+}
+
+template <int ROWS, int COLS, FaceOrigin ORIGIN = FACE_TOP_LEFT, FaceWiring WIRING = FACE_ALONG_ROWS>
+struct FaceGeometry {
+  static constexpr int ROW_COUNT = ROWS;
+  static constexpr int COL_COUNT = COLS;
+  static constexpr int PIXELS = ROWS * COLS;
+
+  // row and column counted from the corner where the strip starts
+  static constexpr int stripRow(int row) {
+    return (ORIGIN == FACE_BOTTOM_LEFT || ORIGIN == FACE_BOTTOM_RIGHT) ? ROWS - 1 - row : row;
+  }
+  static constexpr int stripCol(int col) {
+    return (ORIGIN == FACE_TOP_RIGHT || ORIGIN == FACE_BOTTOM_RIGHT) ? COLS - 1 - col : col;
+  }
+
+  // (row, col) -> position on the LED strip
+  static constexpr int index(int row, int col) {
+    return (row < 0 || row >= ROWS || col < 0 || col >= COLS) ? faceCoordinateOutOfRange()
+         : (WIRING == FACE_ALONG_ROWS)
+             ? stripRow(row) * COLS + ((stripRow(row) & 1) ? COLS - 1 - stripCol(col) : stripCol(col))
+             : stripCol(col) * ROWS + ((stripCol(col) & 1) ? ROWS - 1 - stripRow(row) : stripRow(row));
+  }
+};
+
+#endif
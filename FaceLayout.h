@@ -0,0 +1,165 @@
+#ifndef FACE_LAYOUT_H
+#define FACE_LAYOUT_H
+
+/* The face itself: the grid, the letters, where the words and symbols are, and the
+ * colour each thing gets. Nothing in here needs the Arduino core, a strip or WiFi, so
+ * FaceRenderer (and whatever renders faces off the clock, a dashboard on a host) can
+ * have it without the rest of WordClock.h.
+ *
+ * The colour names in the macros below (White, Dark, Orange, ...) are whatever is in
+ * scope where they're used: the strip's globals in WordClock.h, or FaceRenderer's
+ * palette at the level of the frame it's rendering.
+ */
+
+#include <stdint.h>
+#include "FaceGeometry.h"       // grid size and LED strip wiring
+
+// 12x12=144 LEDs, strip starts top left and meanders along the rows
+typedef FaceGeometry<12, 12, FACE_TOP_LEFT, FACE_ALONG_ROWS> Face;
+#define FACE(row, col) Face::index(row, col)
+#define NEO_PIXELS Face::PIXELS
+
+// 144 char string which mimics the clock face, in a meander pattern - used to spit out the time on the Serial interface
+// (plain constexpr char array: lives in flash, no std::string on the heap at static init)
+static constexpr char wordClockString[] = "aSZISCH!*)w@LETREIVJDLABZWEISFuFACHTFLoWZXFLEuRDSaCHSIEBaZaHKGIZNAWZaNuNVORAB&VHALBIITHCABIFLoWZDRuFuFIZaHNIYIREIVWSIEWZSaCHSIEBNIGQISGPINuNIFLE";
+static_assert(sizeof(wordClockString) - 1 == NEO_PIXELS, "wordClockString needs one letter per LED");
+// const String "ÄSZISCH#####LETREIVJDLABZWEISFÜFACHTFLÖWZXFLEÜRDSÄCHSIEBÄZÄHKGIZNAWZÄNÜNVORAB#VHALBIITHCABIFLÖWZDRÜFÜFIZÄHNIYIREIVWSIEWZSÄCHSIEBNIGQISGPINÜNIFLE";
+
+// gamma correction LUT
+static const uint8_t gamma8[] = {
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
+    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
+    1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
+    2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
+    5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
+   10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
+   17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
+   25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
+   37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
+   51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
+   69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
+   90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
+  115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
+  144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
+  177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
+  215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255  
+};
+
+// Colour shortcuts for symbols
+// note - these are pre-processor macros
+// actual code will be compiles with Silver, Black, Orange, etc.
+// Colours Black, Dark. Grey, Silver, White, Red, Green Blue etc will be adjusted for contrast and brightness
+// during the diurnal cycle - bright at lunchtime, dark at midnight
+#define FOREGROUNDCOLOR  White
+#define BACKGROUNDCOLOR  Dark
+#define TESTCOLOR        Orange
+#define WIFIDISCONNECTED Red
+#define WIFICONNECTING   Orange
+#define WIFICONNECTED    Blue
+#define NTP_NOT_SET      Blue
+#define NTP_SET          Green
+#define THECOLOROFLOVE   Red
+#define CHRISTMASCOLOR   Green
+#define EASTERCOLOR      Yellow
+#define HALLOWEEN_0      White
+#define HALLOWEEN_1      Yellow
+#define HALLOWEEN_2      Orange
+#define HALLOWEEN_3      Red
+#define SUN_COLOR        Yellow
+#define MOON_COLOR       Cyan
+#define WARNING_COLOR    Orange
+#define MESSAGE_COLOR    Magenta
+
+// Various symbols on the clock face
+// each special symbol is mapped to an LED on the face, in (row, col) grid coordinates
+// FaceGeometry takes care of the string zigzagging back and forth over the clock
+static constexpr int symbolWiFi[] = { FACE(0, 11), -1 };     // show [@]  when WiFi connected (blue=connecting, green=OK, red=disconnected)
+static constexpr int symbolTime[] = { FACE(0, 10), -1 };     // show [#]  when ntp is synced 
+static constexpr int symbolMoon[] = { FACE(0, 9), -1 };      // show [o]  at night (if !(sunrise.isVisible) ) [O]
+static constexpr int symbolSun[] = { FACE(0, 8), -1 };       // show [*]  during daytime (if sunrise.isVisible)
+static constexpr int symbolLove[] = { FACE(6, 5), -1 };      // show [<3] on dd/mm/yyyy only
+static constexpr int symbolChristmas[] = { FACE(3, 6), -1 }; // show [Xmas tree] on 25/12/yyyy only
+static constexpr int symbolEaster[] = { FACE(9, 5), -1 };    // show [chicken] on Easter Sunday only
+static constexpr int symbolHalloween[] = { FACE(5, 11), -1 };// show [Ghost] on Halloween (31/10/yyyy) only
+static constexpr int symbolWarning[] = { FACE(0, 7), -1 };   // show [!]  some sort of error display (not used yet)
+
+// Various useful (?) words on the clock face
+// static constexpr int arrayname[] = { FACE(row, col), FACE(row, col), ..., finished with a -1 }
+static constexpr int wordNone[] = { -1 };
+static constexpr int wordIt[] = { FACE(0, 0), FACE(0, 1), -1 };
+static constexpr int wordIs[] = { FACE(0, 3), FACE(0, 4), FACE(0, 5), FACE(0, 6), -1 };
+static constexpr int wordSoon[] = { FACE(1, 0), FACE(1, 1), FACE(1, 2), FACE(1, 3), -1 };
+static constexpr int wordQuarter[] = { FACE(1, 5), FACE(1, 6), FACE(1, 7), FACE(1, 8), FACE(1, 9), FACE(1, 10), FACE(1, 11), -1 };
+static constexpr int wordHalf[] = { FACE(6, 7), FACE(6, 8), FACE(6, 9), FACE(6, 10), FACE(6, 11), -1 };
+static constexpr int wordTo[] = { FACE(6, 0), FACE(6, 1), FACE(6, 2), -1 };
+static constexpr int wordPast[] = { FACE(6, 3), FACE(6, 4), -1 };
+static constexpr int wordBeen[] = { FACE(11, 9), FACE(11, 10), FACE(11, 11), -1 };
+
+// all the 29 minute words (past, to), including some compounds
+static constexpr int wordMinuteOne[] = { FACE(2, 2), FACE(2, 3), FACE(2, 4), -1 };
+static constexpr int wordMinuteTwo[] = { FACE(2, 0), FACE(2, 1), FACE(2, 2), FACE(2, 3), -1 };
+static constexpr int wordMinuteThree[] = { FACE(3, 0), FACE(3, 1), FACE(3, 2), -1 };
+static constexpr int wordMinuteFour[] = { FACE(1, 5), FACE(1, 6), FACE(1, 7), FACE(1, 8), -1 };
+static constexpr int wordMinuteFive[] = { FACE(2, 5), FACE(2, 6), FACE(2, 7), -1 };
+static constexpr int wordMinuteSix[] = { FACE(4, 0), FACE(4, 1), FACE(4, 2), FACE(4, 3), FACE(4, 4), -1 };
+static constexpr int wordMinuteSeven[] = { FACE(4, 4), FACE(4, 5), FACE(4, 6), FACE(4, 7), FACE(4, 8), -1 };
+static constexpr int wordMinuteEight[] = { FACE(2, 8), FACE(2, 9), FACE(2, 10), FACE(2, 11), -1 };
+static constexpr int wordMinuteNine[] = { FACE(5, 0), FACE(5, 1), FACE(5, 2), -1 };
+static constexpr int wordMinuteTen[] = { FACE(4, 9), FACE(4, 10), FACE(4, 11), -1 };
+static constexpr int wordMinuteEleven[] = { FACE(3, 3), FACE(3, 4), FACE(3, 5), -1 };
+static constexpr int wordMinuteTwelve[] = { FACE(3, 7), FACE(3, 8), FACE(3, 9), FACE(3, 10), FACE(3, 11), -1 };
+static constexpr int wordMinuteTwenty[] = { FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };
+static constexpr int wordMinuteTwentyOne[] = { FACE(2, 2), FACE(2, 3), FACE(5, 2), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };                // for EINaZWANZIG
+static constexpr int wordMinuteTwentyTwo[] = { FACE(2, 0), FACE(2, 1), FACE(2, 2), FACE(2, 3), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };            // for ZweiaZWANZIG
+static constexpr int wordMinuteTwentyThree[] = { FACE(3, 0), FACE(3, 1), FACE(3, 2), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };              // for DruaZWANZIG
+static constexpr int wordMinuteTwentyFour[] = { FACE(1, 5), FACE(1, 6), FACE(1, 7), FACE(1, 8), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };           // for VIERaZWANZIG
+static constexpr int wordMinuteTwentyFive[] = { FACE(2, 5), FACE(2, 6), FACE(2, 7), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };               // for FuFaZWANZIG
+static constexpr int wordMinuteTwentySix[] = { FACE(4, 0), FACE(4, 1), FACE(4, 2), FACE(4, 3), FACE(4, 4), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };        // for SaCHSaZWANZIG
+static constexpr int wordMinuteTwentySeven[] = { FACE(4, 4), FACE(4, 5), FACE(4, 6), FACE(4, 7), FACE(4, 8), FACE(5, 2), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };  // for SIEBaNaZWANZIG
+static constexpr int wordMinuteTwentyEight[] = { FACE(2, 8), FACE(2, 9), FACE(2, 10), FACE(2, 11), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };          // for ACHTaZWANZIG
+static constexpr int wordMinuteTwentyNine[] = { FACE(5, 0), FACE(5, 1), FACE(5, 2), FACE(5, 3), FACE(5, 4), FACE(5, 5), FACE(5, 6), FACE(5, 7), FACE(5, 8), FACE(5, 9), FACE(5, 10), -1 };               // for NuNaZWANZIG
+
+// how the minute words go together is up to the phrase mode, see PhraseMode.cpp
+
+/*  Matrix for the clock face. 
+*   Matches the clock face character string
+*   Every second line is in reverse
+*   (LED string meanders)
+* 
+*      012345678901
+*   0--aS.ISCH.####---11
+*  23--BALD.VIERTEL---12
+*  24--ZWEISFuFACHT---35
+*  47--DRuELF.ZWoLF---36
+*  48--SaCHSIEBaZaH---59
+*  71--NuNaZWANZIG.---60
+*  72--HALBI#VOR.AB---83
+*  95--ZWoLFI.ACHTI---84
+*  96--DRuFuFiZaHNI--107 
+* 119--ZWEIS.VIERI.--108
+* 120--SaCHSIEBNI.#--131
+* 143--ELFINuNI.GSI--132
+*      012345678901  */
+
+// all 12 word hours
+static constexpr int wordHourOne[] = { FACE(9, 2), FACE(9, 3), FACE(9, 4), -1 };
+static constexpr int wordHourTwo[] = { FACE(9, 0), FACE(9, 1), FACE(9, 2), FACE(9, 3), -1 };
+static constexpr int wordHourThree[] = { FACE(8, 0), FACE(8, 1), FACE(8, 2), -1 };
+static constexpr int wordHourFour[] = { FACE(9, 6), FACE(9, 7), FACE(9, 8), FACE(9, 9), FACE(9, 10), -1 };
+static constexpr int wordHourFive[] = { FACE(8, 3), FACE(8, 4), FACE(8, 5), FACE(8, 6), -1 };
+static constexpr int wordHourSix[] = { FACE(10, 0), FACE(10, 1), FACE(10, 2), FACE(10, 3), FACE(10, 4), FACE(10, 5), -1 };
+static constexpr int wordHourSeven[] = { FACE(10, 4), FACE(10, 5), FACE(10, 6), FACE(10, 7), FACE(10, 8), FACE(10, 9), -1 };
+static constexpr int wordHourEight[] = { FACE(7, 7), FACE(7, 8), FACE(7, 9), FACE(7, 10), FACE(7, 11), -1 };
+static constexpr int wordHourNine[] = { FACE(11, 4), FACE(11, 5), FACE(11, 6), FACE(11, 7), -1 };
+static constexpr int wordHourTen[] = { FACE(8, 7), FACE(8, 8), FACE(8, 9), FACE(8, 10), FACE(8, 11), -1 };
+static constexpr int wordHourEleven[] = { FACE(11, 0), FACE(11, 1), FACE(11, 2), FACE(11, 3), -1 };
+static constexpr int wordHourTwelve[] = { FACE(7, 0), FACE(7, 1), FACE(7, 2), FACE(7, 3), FACE(7, 4), FACE(7, 5), -1 };
+
+// assemble 12+1 hours
+static const int* const wordHours[] = { wordHourTwelve, wordHourOne, wordHourTwo,
+                            wordHourThree, wordHourFour, wordHourFive,
+                            wordHourSix, wordHourSeven, wordHourEight,
+                            wordHourNine, wordHourTen, wordHourEleven,
+                            wordHourTwelve };
+
+#endif
@@ -0,0 +1,483 @@
+/*
+ * This is FaceMirror.cpp
+ */
+
+#include "WordClock.h"          // FACE_MIRROR switch, wordClockString, Face
+#ifdef FACE_MIRROR
+#include <lwip/sockets.h>
+#include <mbedtls/sha1.h>       // part of ESP-IDF
+#include <mbedtls/base64.h>
+
+#define MIRROR_WS_GUID "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define MIRROR_WS_KEY "Sec-WebSocket-Key:"
+
+enum { MIRROR_FULL = 0, MIRROR_DELTA = 1, MIRROR_FRAME = 2 };
+
+// the whole response, headers and all, sent straight from flash
+static const char mirrorPage[] =
+  "HTTP/1.1 200 OK\r\n"
+  "Content-Type: text/html; charset=utf-8\r\n"
+  "Cache-Control: no-cache\r\n"
+  "Connection: close\r\n"
+  "\r\n"
+  "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>" HOSTNAME "</title><style>"
+  "body{background:#000;color:#666;font-family:monospace}"
+  "#f{display:grid;gap:.3em;font-size:2em;width:max-content;margin:1em}#f span{text-align:center;width:1.2em}"
+  "</style></head><body><div id=\"f\"></div><p id=\"s\">connecting</p><script>"
+  "var f=document.getElementById('f'),s=document.getElementById('s'),c=[],N=0,n=0,b=0,u={a:'\xC3\x84',o:'\xC3\x96',u:'\xC3\x9C'};"
+  "function px(d,i,p){if(c[p])c[p].style.color='rgb('+d[i]+','+d[i+1]+','+d[i+2]+')';}"
+  "var w=new WebSocket('ws://'+location.host+'/ws');w.binaryType='arraybuffer';"
+  "w.onmessage=function(e){var d=new Uint8Array(e.data),i,p;n++;b+=d.length;"
+  "if(d[0]==0){N=(d.length-2)/4;f.style.gridTemplateColumns='repeat('+d[1]+',1.2em)';f.innerHTML='';c=[];"
+  "for(p=0;p<N;p++){var l=String.fromCharCode(d[2+p]),t=document.createElement('span');"
+  "t.textContent=u[l]||l;f.appendChild(t);c.push(t);px(d,2+N+3*p,p);}}"
+  "else if(d[0]==1){for(i=1;i+4<d.length;i+=5)px(d,i+2,d[i]|d[i+1]<<8);}"
+  "else if(d[0]==2){for(p=0;p<N;p++)px(d,1+3*p,p);}"
+  "s.textContent=n+' frames, '+b+' bytes';};"
+  "w.onclose=function(){s.textContent='disconnected';};"
+  "</script></body></html>";
+
+static const char mirrorNotFound[] =
+  "HTTP/1.1 404 Not Found\r\n"
+  "Content-Length: 0\r\n"
+  "Connection: close\r\n"
+  "\r\n";
+
+FaceMirror::FaceMirror() {
+  _listen = -1;
+  _task = NULL;
+  _seq = 0;
+  memset(_latest, 0, sizeof(_latest));
+  memset(_frames, 0, sizeof(_frames));
+  memset(_payloadBytes, 0, sizeof(_payloadBytes));
+  _headerBytes = 0;
+  _skipped = 0;
+  _accepted = 0;
+  _rejected = 0;
+  _timedOut = 0;
+  for (int i = 0; i < MIRROR_CLIENTS; i++) {
+    _clients[i].socket = -1;
+  };
+};
+
+// call once WiFi is up: the listening socket and the task, for good
+void FaceMirror::begin() {
+  _listen = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+  if (_listen < 0) {
+    return;
+  };
+  int on = 1;
+  setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(MIRROR_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(_listen, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(_listen, 2) < 0) {
+#ifdef ECHO
+    Serial.println("Mirror: can't listen");
+#endif
+    close(_listen);
+    _listen = -1;
+    return;
+  };
+  fcntl(_listen, F_SETFL, O_NONBLOCK);
+#ifndef COOPERATIVE
+  xTaskCreatePinnedToCore(_taskMain, "mirror", MIRROR_TASK_STACK, this, 1, &_task, MIRROR_TASK_CORE);
+#endif
+};
+
+// the frame on the strip, reading order; a copy and we're done, whoever is watching
+void FaceMirror::publish(const uint8_t *rgb) {
+  portENTER_CRITICAL(&_lock);
+  memcpy(_latest, rgb, sizeof(_latest));
+  _seq = _seq + 1 == 0 ? 1 : _seq + 1;  // 0 means "no frame"
+  portEXIT_CRITICAL(&_lock);
+};
+
+void FaceMirror::stats(Print &out) {
+  static const char *const names[] = { "full", "delta", "frame" };
+  int clients = 0;
+  for (int i = 0; i < MIRROR_CLIENTS; i++) {
+    if (_clients[i].socket >= 0 && _clients[i].upgraded) {
+      clients++;
+    };
+  };
+  out.print("Mirror: ");
+  out.print(clients);
+  out.print(" viewer(s), ");
+  out.print(_accepted);
+  out.print(" connections, ");
+  out.print(_rejected);
+  out.print(" turned away, ");
+  out.print(_timedOut);
+  out.println(" timed out");
+  uint32_t frames = 0;
+  uint32_t bytes = 0;
+  for (int t = 0; t < 3; t++) {
+    out.print("Mirror: ");
+    out.print(names[t]);
+    out.print(" ");
+    out.print(_frames[t]);
+    out.print(" x, ");
+    out.print(_payloadBytes[t]);
+    out.print(" bytes");
+    if (_frames[t] > 0) {
+      out.print(", ");
+      out.print(_payloadBytes[t] / _frames[t]);
+      out.print(" each");
+    };
+    out.println();
+    frames += _frames[t];
+    bytes += _payloadBytes[t];
+  };
+  out.print("Mirror: WebSocket headers ");
+  out.print(_headerBytes);
+  out.print(" bytes (");
+  out.print(bytes > 0 ? 100.0 * _headerBytes / bytes : 0.0);
+  out.print("%), ");
+  out.print(_skipped);
+  out.print(" frames skipped by slow viewers, ");
+  out.print(frames > 0 ? (float)(bytes + _headerBytes) / frames : 0.0);
+  out.println(" bytes per frame sent");
+};
+
+void FaceMirror::_taskMain(void *arg) {
+  FaceMirror *self = (FaceMirror *)arg;
+  for (;;) {
+    self->_poll();
+  };
+};
+
+#ifdef COOPERATIVE
+// a round without waiting, nothing to do if begin() couldn't listen
+void FaceMirror::poll() {
+  if (_listen >= 0) {
+    _poll();
+  };
+};
+#endif
+
+// one round: whatever the sockets have for us, then the newest frame to idle clients
+void FaceMirror::_poll() {
+  fd_set readable;
+  fd_set writable;
+  FD_ZERO(&readable);
+  FD_ZERO(&writable);
+  FD_SET(_listen, &readable);
+  int top = _listen;
+  for (int i = 0; i < MIRROR_CLIENTS; i++) {
+    Client &c = _clients[i];
+    if (c.socket < 0) {
+      continue;
+    };
+    FD_SET(c.socket, &readable);
+    if (c.queueSent < c.queueLen || c.bulkLen > 0) {
+      FD_SET(c.socket, &writable);
+    };
+    if (c.socket > top) {
+      top = c.socket;
+    };
+  };
+  struct timeval tv;
+  tv.tv_sec = 0;
+#ifdef COOPERATIVE
+  tv.tv_usec = 0;                   // the scheduler does the waiting
+#else
+  tv.tv_usec = MIRROR_TICK * 1000;
+#endif
+  if (select(top + 1, &readable, &writable, NULL, &tv) > 0) {
+    if (FD_ISSET(_listen, &readable)) {
+      _accept();
+    };
+    for (int i = 0; i < MIRROR_CLIENTS; i++) {
+      Client &c = _clients[i];
+      if (c.socket >= 0 && FD_ISSET(c.socket, &readable)) {
+        _read(c);
+      };
+      if (c.socket >= 0 && FD_ISSET(c.socket, &writable)) {
+        _write(c);
+      };
+    };
+  };
+  for (int i = 0; i < MIRROR_CLIENTS; i++) {
+    if (_clients[i].socket >= 0) {
+      _idle(_clients[i]);
+    };
+  };
+
+  // only clients with nothing left in their queue get the new frame
+  bool copied = false;
+  uint32_t seq = 0;
+  for (int i = 0; i < MIRROR_CLIENTS; i++) {
+    Client &c = _clients[i];
+    if (c.socket < 0 || !c.upgraded || c.queueLen > 0 || c.seq == _seq || _seq == 0) {
+      continue;
+    };
+    if (!copied) {
+      portENTER_CRITICAL(&_lock);
+      memcpy(_frame, _latest, sizeof(_frame));
+      seq = _seq;
+      portEXIT_CRITICAL(&_lock);
+      copied = true;
+    };
+    _update(c, seq);
+    _write(c);
+  };
+};
+
+void FaceMirror::_accept() {
+  int s = accept(_listen, NULL, NULL);
+  if (s < 0) {
+    return;
+  };
+  for (int i = 0; i < MIRROR_CLIENTS; i++) {
+    Client &c = _clients[i];
+    if (c.socket < 0) {
+      fcntl(s, F_SETFL, O_NONBLOCK);
+      int on = 1;
+      setsockopt(s, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+      c.socket = s;
+      c.upgraded = false;
+      c.closing = false;
+      c.requestLen = 0;
+      c.queueLen = 0;
+      c.queueSent = 0;
+      c.bulk = NULL;
+      c.bulkLen = 0;
+      c.seq = 0;
+      c.active = millis();
+      c.pinged = c.active;
+      _accepted++;
+      return;
+    };
+  };
+  // full house
+  close(s);
+  _rejected++;
+};
+
+void FaceMirror::_read(Client &c) {
+  if (!c.upgraded) {
+    int n = recv(c.socket, &c.request[c.requestLen], MIRROR_REQUEST_LEN - 1 - c.requestLen, MSG_DONTWAIT);
+    if (n <= 0) {
+      if (n == 0 || (errno != EWOULDBLOCK && errno != EAGAIN)) {
+        _close(c);
+      };
+      return;
+    };
+    c.requestLen += n;
+    c.request[c.requestLen] = '\0';
+    c.active = millis();
+    if (strstr(c.request, "\r\n\r\n") != NULL) {
+      _request(c);
+    } else if (c.requestLen >= MIRROR_REQUEST_LEN - 1) {
+      _close(c);  // more headers than we care to read
+    };
+    return;
+  };
+  // the browser only ever sends a pong, a close (or a ping), no need to parse it properly
+  uint8_t data[64];
+  int n = recv(c.socket, data, sizeof(data), MSG_DONTWAIT);
+  if (n == 0 || (n < 0 && errno != EWOULDBLOCK && errno != EAGAIN) || (n > 0 && (data[0] & 0x0F) == 0x08)) {
+    _close(c);
+  } else if (n > 0) {
+    c.active = millis();  // still there
+  };
+};
+
+// close a client that stopped getting anywhere, ping a viewer now and then
+void FaceMirror::_idle(Client &c) {
+  uint32_t now = millis();
+  if (!c.upgraded) {
+    if (now - c.active > MIRROR_REQUEST_TIMEOUT) {
+      _timedOut++;
+      _close(c);
+    };
+    return;
+  };
+  if (now - c.active > MIRROR_IDLE_TIMEOUT) {
+    _timedOut++;
+    _close(c);
+    return;
+  };
+  if (now - c.pinged >= MIRROR_PING && c.queueLen == 0) {
+    static const uint8_t ping[2] = { 0x89, 0x00 };  // FIN, ping, no payload
+    _queue(c, ping, sizeof(ping));
+    c.pinged = now;
+    _write(c);
+  };
+};
+
+// GET / is the page, GET /ws the WebSocket, anything else a 404
+void FaceMirror::_request(Client &c) {
+  if (strncmp(c.request, "GET /ws ", 8) != 0) {
+    if (strncmp(c.request, "GET / ", 6) == 0) {
+      c.bulk = mirrorPage;
+      c.bulkLen = sizeof(mirrorPage) - 1;
+    } else {
+      c.bulk = mirrorNotFound;
+      c.bulkLen = sizeof(mirrorNotFound) - 1;
+    };
+    c.closing = true;
+    return;
+  };
+  const char *key = strstr(c.request, MIRROR_WS_KEY);
+  if (key == NULL) {
+    _close(c);
+    return;
+  };
+  key += strlen(MIRROR_WS_KEY);
+  while (*key == ' ') {
+    key++;
+  };
+  const char *end = strstr(key, "\r\n");
+  int len = end - key;
+  char text[64 + sizeof(MIRROR_WS_GUID)];
+  if (len <= 0 || len > 64) {
+    _close(c);
+    return;
+  };
+  // accept = base64(SHA-1(key + GUID))
+  memcpy(text, key, len);
+  memcpy(&text[len], MIRROR_WS_GUID, strlen(MIRROR_WS_GUID));
+  unsigned char sha[20];
+  mbedtls_sha1_ret((const unsigned char *)text, len + strlen(MIRROR_WS_GUID), sha);
+  unsigned char accept[32];
+  size_t acceptLen = 0;
+  mbedtls_base64_encode(accept, sizeof(accept) - 1, &acceptLen, sha, sizeof(sha));
+  accept[acceptLen] = '\0';
+  char response[160];
+  int n = snprintf(response, sizeof(response),
+                   "HTTP/1.1 101 Switching Protocols\r\n"
+                   "Upgrade: websocket\r\n"
+                   "Connection: Upgrade\r\n"
+                   "Sec-WebSocket-Accept: %s\r\n"
+                   "\r\n",
+                   accept);
+  _queue(c, (const uint8_t *)response, n);
+  c.upgraded = true;
+  c.seq = 0;
+};
+
+// the client gets _frame: in full the first time, then as a delta from what it has
+void FaceMirror::_update(Client &c, uint32_t seq) {
+  int type;
+  int len;
+  if (c.seq == 0) {
+    type = MIRROR_FULL;
+    _payload[0] = MIRROR_FULL;
+    _payload[1] = Face::COL_COUNT;
+    for (int p = 0; p < NEO_PIXELS; p++) {
+      _payload[2 + p] = wordClockString[FACE(p / Face::COL_COUNT, p % Face::COL_COUNT)];
+    };
+    memcpy(&_payload[2 + NEO_PIXELS], _frame, sizeof(_frame));
+    len = 2 + NEO_PIXELS + sizeof(_frame);
+  } else {
+    _skipped += seq - c.seq - 1;
+    type = MIRROR_DELTA;
+    _payload[0] = MIRROR_DELTA;
+    len = 1;
+    for (int p = 0; p < NEO_PIXELS; p++) {
+      if (memcmp(&_frame[3 * p], &c.rgb[3 * p], 3) == 0) {
+        continue;
+      };
+      if (len + 5 > 1 + (int)sizeof(_frame)) {
+        type = MIRROR_FRAME;  // most of the face changed, the plain frame is shorter
+        break;
+      };
+      _payload[len++] = p & 0xFF;
+      _payload[len++] = p >> 8;
+      memcpy(&_payload[len], &_frame[3 * p], 3);
+      len += 3;
+    };
+    if (type == MIRROR_FRAME) {
+      _payload[0] = MIRROR_FRAME;
+      memcpy(&_payload[1], _frame, sizeof(_frame));
+      len = 1 + sizeof(_frame);
+    } else if (len == 1) {
+      c.seq = seq;  // same picture again, nothing to send
+      return;
+    };
+  };
+  if (_message(c, type, len)) {
+    memcpy(c.rgb, _frame, sizeof(_frame));
+    c.seq = seq;
+  };
+};
+
+// _payload as one binary WebSocket frame (server frames aren't masked)
+bool FaceMirror::_message(Client &c, int type, int len) {
+  uint8_t head[4];
+  int h;
+  head[0] = 0x82;  // FIN, binary
+  if (len < 126) {
+    head[1] = len;
+    h = 2;
+  } else {
+    head[1] = 126;
+    head[2] = len >> 8;
+    head[3] = len & 0xFF;
+    h = 4;
+  };
+  if (c.queueLen + h + len > MIRROR_QUEUE) {
+    return false;
+  };
+  _queue(c, head, h);
+  _queue(c, _payload, len);
+  _frames[type]++;
+  _payloadBytes[type] += len;
+  _headerBytes += h;
+  return true;
+};
+
+bool FaceMirror::_queue(Client &c, const uint8_t *data, int len) {
+  if (c.queueLen + len > MIRROR_QUEUE) {
+    return false;
+  };
+  memcpy(&c.queue[c.queueLen], data, len);
+  c.queueLen += len;
+  return true;
+};
+
+// as much as the socket takes without waiting; the queue first, then the page
+void FaceMirror::_write(Client &c) {
+  if (c.queueSent < c.queueLen) {
+    int n = send(c.socket, &c.queue[c.queueSent], c.queueLen - c.queueSent, MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno != EWOULDBLOCK && errno != EAGAIN) {
+        _close(c);
+      };
+      return;
+    };
+    c.queueSent += n;
+    if (c.queueSent < c.queueLen) {
+      return;
+    };
+    c.queueSent = 0;
+    c.queueLen = 0;
+  };
+  if (c.bulkLen > 0) {
+    int n = send(c.socket, c.bulk, c.bulkLen, MSG_DONTWAIT);
+    if (n < 0) {
+      if (errno != EWOULDBLOCK && errno != EAGAIN) {
+        _close(c);
+      };
+      return;
+    };
+    c.bulk += n;
+    c.bulkLen -= n;
+    c.active = millis();
+  };
+  if (c.closing && c.queueLen == 0 && c.bulkLen == 0) {
+    _close(c);
+  };
+};
+
+void FaceMirror::_close(Client &c) {
+  close(c.socket);
+  c.socket = -1;
+  c.upgraded = false;
+};
+
+#endif  // FACE_MIRROR
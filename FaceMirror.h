@@ -0,0 +1,108 @@
+#ifndef FACE_MIRROR_H
+#define FACE_MIRROR_H
+
+/* The live face in a browser (#define FACE_MIRROR in WordClock.h).
+ *
+ * http://<clock>:MIRROR_PORT/ is a page that draws the face; it opens a WebSocket
+ * on /ws and gets the framebuffer, in reading order:
+ *
+ *   full   0x00, columns, letters[NEO_PIXELS], rgb[3 * NEO_PIXELS]  on connect
+ *   delta  0x01, { index lo, index hi, r, g, b } per changed pixel
+ *   frame  0x02, rgb[3 * NEO_PIXELS]     when a delta would be bigger than that
+ *
+ * A minute flip changes a dozen or two pixels, 1 + 5 bytes each, so most frames are
+ * 60-120 bytes plus a 2 byte WebSocket header.
+ *
+ * _show() hands every frame to publish(), which copies it (under a spinlock) and
+ * returns; it never waits for a viewer. Everything else runs in our own task on
+ * core 0 around one select(): accepting, the HTTP request and the WebSocket
+ * handshake (SHA-1 and base64 from mbedtls), and sending. Each client has its own
+ * send queue of MIRROR_QUEUE bytes and remembers the frame it was last sent; a new
+ * frame is only queued once the queue has drained, as a delta from that one. A slow
+ * viewer just gets fewer, bigger deltas, and never holds up the others or the clock.
+ * At most MIRROR_CLIENTS viewers, more are turned away.
+ *
+ * So a slot can't be held for good, every client is stamped with the last time it
+ * got anywhere. An HTTP request has MIRROR_REQUEST_TIMEOUT to arrive and its answer
+ * as long again per bit of progress. A viewer gets a WebSocket ping every MIRROR_PING
+ * ms, which browsers answer by themselves; one that hasn't sent us anything for
+ * MIRROR_IDLE_TIMEOUT is gone (left without a FIN, say) and is closed.
+ *
+ * With COOPERATIVE there's no task: poll() is one round with a select() that doesn't
+ * wait, and loop()'s scheduler calls it every MIRROR_TICK ms.
+ *
+ * stats() (Serial 'w') prints what went over the wire: frames and bytes by type, the
+ * WebSocket header bytes on top, and how many frames slow clients skipped.
+ * tools/mirror_clients.py opens a number of viewers, some of them slow, to measure
+ * that against a clock on the LAN.
+ */
+
+#include <Arduino.h>
+
+#define MIRROR_PORT 80
+#define MIRROR_CLIENTS 4
+#define MIRROR_QUEUE 1024           // bytes, a full frame plus a few deltas
+#define MIRROR_REQUEST_LEN 512      // HTTP request headers we look at
+#define MIRROR_TICK 20              // ms select() waits, then looks for a new frame
+#define MIRROR_REQUEST_TIMEOUT 5000 // ms without progress on the HTTP request or answer
+#define MIRROR_PING 10000           // ms between pings to a viewer
+#define MIRROR_IDLE_TIMEOUT 30000   // ms without a word (a pong) from a viewer
+#define MIRROR_TASK_STACK 4096
+#define MIRROR_TASK_CORE 0
+
+class FaceMirror {
+public:
+  FaceMirror();
+  void begin();
+  void publish(const uint8_t *rgb);
+  void stats(Print &out);
+#ifdef COOPERATIVE
+  void poll();
+#endif
+private:
+  struct Client {
+    int socket;                     // -1: free
+    bool upgraded;                  // WebSocket, else still an HTTP request
+    bool closing;                   // close once everything is sent
+    char request[MIRROR_REQUEST_LEN];
+    int requestLen;
+    uint8_t queue[MIRROR_QUEUE];
+    int queueLen;
+    int queueSent;
+    const char *bulk;               // the page, straight from flash
+    int bulkLen;
+    uint32_t seq;                   // frame in rgb, 0: none yet
+    uint32_t active;                // millis() it last got somewhere
+    uint32_t pinged;                // millis() of the last ping
+    uint8_t rgb[NEO_PIXELS * 3];    // what the client has (once the queue is out)
+  };
+  int _listen;
+  TaskHandle_t _task;
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+  uint8_t _latest[NEO_PIXELS * 3];  // under _lock
+  volatile uint32_t _seq;
+  uint8_t _frame[NEO_PIXELS * 3];   // task side copy of _latest
+  uint8_t _payload[1 + 2 + NEO_PIXELS * 4];
+  Client _clients[MIRROR_CLIENTS];
+  // stats, written by the task only
+  uint32_t _frames[3];
+  uint32_t _payloadBytes[3];
+  uint32_t _headerBytes;
+  uint32_t _skipped;
+  uint32_t _accepted;
+  uint32_t _rejected;
+  uint32_t _timedOut;
+  static void _taskMain(void *arg);
+  void _poll();
+  void _accept();
+  void _read(Client &c);
+  void _request(Client &c);
+  void _update(Client &c, uint32_t seq);
+  void _write(Client &c);
+  void _idle(Client &c);
+  bool _queue(Client &c, const uint8_t *data, int len);
+  bool _message(Client &c, int type, int len);
+  void _close(Client &c);
+};
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ * This is FaceRenderer.cpp
+ */
+
+#include "FaceRenderer.h"       // and through it the word and symbol pixel lists, colour macros
+#include <math.h>
+#include <stdlib.h>
+#include <TimeLib.h>            // https://github.com/PaulStoffregen/Time
+#include <Timezone.h>           // https://github.com/JChristensen/Timezone
+#include <SunRise.h>            // https://github.com/signetica/SunRise
+#include <MoonRise.h>           // https://github.com/signetica/MoonRise
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#ifdef ESP_PLATFORM
+#include <esp_pthread.h>
+#endif
+
+// bits of mask word w for the LEDs of a -1 terminated pixel list
+static constexpr uint32_t wordBits(const int *word, int w) {
+  return *word < 0 ? 0 : (((*word >> 5) == w ? (1UL << (*word & 31)) : 0) | wordBits(word + 1, w));
+}
+
+template <int... W>
+static constexpr FrameMask wordMask(const int *word, FrameMaskIndex<W...>) {
+  return FrameMask{ { wordBits(word, W)... } };
+}
+
+#define WORD_MASK(word) wordMask(word, FrameMaskMakeIndex<FRAME_MASK_WORDS>::type())
+
+// all in flash, nothing of this is computed on the clock
+static constexpr FrameMask maskItIs[] = { WORD_MASK(wordIt), WORD_MASK(wordIs) };
+
+// same order as enum PhraseWord; PW_NONE is empty, ORing it in is harmless
+static constexpr FrameMask phraseMasks[] = {
+  WORD_MASK(wordNone),
+  WORD_MASK(wordSoon), WORD_MASK(wordQuarter), WORD_MASK(wordHalf), WORD_MASK(wordTo), WORD_MASK(wordPast), WORD_MASK(wordBeen),
+  WORD_MASK(wordMinuteOne), WORD_MASK(wordMinuteTwo), WORD_MASK(wordMinuteThree), WORD_MASK(wordMinuteFour),
+  WORD_MASK(wordMinuteFive), WORD_MASK(wordMinuteSix), WORD_MASK(wordMinuteSeven), WORD_MASK(wordMinuteEight),
+  WORD_MASK(wordMinuteNine), WORD_MASK(wordMinuteTen), WORD_MASK(wordMinuteEleven), WORD_MASK(wordMinuteTwelve),
+  WORD_MASK(wordMinuteTwenty),
+  WORD_MASK(wordMinuteTwentyOne), WORD_MASK(wordMinuteTwentyTwo), WORD_MASK(wordMinuteTwentyThree),
+  WORD_MASK(wordMinuteTwentyFour), WORD_MASK(wordMinuteTwentyFive), WORD_MASK(wordMinuteTwentySix),
+  WORD_MASK(wordMinuteTwentySeven), WORD_MASK(wordMinuteTwentyEight), WORD_MASK(wordMinuteTwentyNine)
+};
+static_assert(sizeof(phraseMasks) / sizeof(phraseMasks[0]) == PW_COUNT, "phraseMasks[] must follow enum PhraseWord");
+
+// as wordHours[]: 12, 1, 2, ... 11, 12, so the next hour is always + 1
+static constexpr FrameMask hourMasks[] = {
+  WORD_MASK(wordHourTwelve), WORD_MASK(wordHourOne), WORD_MASK(wordHourTwo), WORD_MASK(wordHourThree),
+  WORD_MASK(wordHourFour), WORD_MASK(wordHourFive), WORD_MASK(wordHourSix), WORD_MASK(wordHourSeven),
+  WORD_MASK(wordHourEight), WORD_MASK(wordHourNine), WORD_MASK(wordHourTen), WORD_MASK(wordHourEleven),
+  WORD_MASK(wordHourTwelve)
+};
+
+// as Adafruit_NeoPixel::Color(), without needing a strip
+static inline uint32_t rgb(uint8_t r, uint8_t g, uint8_t b) {
+  return ((uint32_t)r << 16) | ((uint32_t)g << 8) | b;
+}
+
+static void setSymbol(FaceRenderer::Frame &out, const int *symbol, uint32_t color) {
+  for (int i = 0; symbol[i] >= 0; i++) {
+    out.pixel[symbol[i]] = color;
+    out.lit.set(symbol[i]);
+  };
+}
+
+// "ES ISCH", the minute words and the hour; no branches, PW_NONE adds nothing
+void FaceRenderer::words(int hour, int minute, const PhraseMode &phrase, FrameMask &out) {
+  const PhraseMinute &pm = phrase.minutes[minute];
+  out = maskItIs[0] | maskItIs[1] | hourMasks[(hour % 12) + pm.nextHour];
+  for (int i = 0; i < PHRASE_WORDS; i++) {
+    out |= phraseMasks[pm.words[i]];
+  };
+};
+
+// bright at lunchtime, dark at midnight
+// LEVEL = int(brightness - (contrast * brightness / 255.0) * ((1 + cos(phase)) / 2))
+// unless a light sensor knows better
+int FaceRenderer::level(int hour, int minute, const Config &config) {
+  if (config.ambient >= 0) {
+    return config.ambient * config.brightness / 255;
+  };
+  float phase = 2 * M_PI * (hour * 60.0 + minute * 1.0) / (24.0 * 60.0);
+  return int(config.brightness - (config.contrast * config.brightness / 255.0) * ((1 + cos(phase)) / 2));
+};
+
+// Easter Sunday, Gauss' algorithm
+bool FaceRenderer::easter(int y, int m, int d) {
+  float A = y % 19;  // Metonic cycle
+  float B = y % 4;   // Leap years
+  float C = y % 7;   // 52 weeks test
+  float P = floor((float)y / 100.0);
+  float Q = floor((float)(13 + 8 * P) / 25.0);
+  float M = (int)(15 - Q + P - floor(P / 4)) % 30;  // M depends on the century of year Y. For 19th century, M = 23. For the 21st century, M = 24 and so on.
+  float N = (int)(4 + P - floor(P / 4)) % 7;        // difference between the number of leap days between the Julian and the Gregorian calendar
+  float D = (int)(19 * A + M) % 30;                 // number of days to be added to March 21 to find the date of the Paschal Full Moon
+  float E = (int)(N + 2 * B + 4 * C + 6 * D) % 7;   // number of days from the Paschal full moon to the next Sunday
+  int days = (int)(22 + D + E);
+  int e_m;
+  int e_d;
+  if (D == 29 && E == 6) {  // this is a an edge case
+    e_m = 4;
+    e_d = 19;
+  } else if (D == 28 && E == 6) {  // this is a an edge case
+    e_m = 4;
+    e_d = 18;
+  } else if (days > 31) {
+    // If days > 31, move to April
+    e_m = 4;
+    e_d = days - 31;
+  } else {
+    // Otherwise, stay on March
+    e_m = 3;
+    e_d = days;
+  };
+  return m == e_m && d == e_d;
+};
+
+void FaceRenderer::render(time_t utc, const Device &device, uint8_t status, Frame &out) {
+  // toLocal() caches the DST switch times in the object, so work on a copy
+  Timezone tz = *device.tz;
+  tmElements_t tm;
+  breakTime(tz.toLocal(utc), tm);
+  const Config &config = device.config;
+  int L = level(tm.Hour, tm.Minute, config);
+  out.level = L;
+
+  // the palette at this level, under the names the colour macros in FaceLayout.h use
+  // (in WordClock these hide the globals, which belong to whoever drives the strip)
+  uint32_t Dark = rgb(2 * L / 8, 2 * L / 8, 2 * L / 8);
+  uint32_t White = rgb(L, L, L);
+  uint32_t Red = rgb(L, 0, 0);
+  uint32_t Orange = rgb(L, L / 2, 0);
+  uint32_t Yellow = rgb(L, L, 0);
+  uint32_t Green = rgb(0, L, 0);
+  uint32_t Blue = rgb(0, 0, L);
+  uint32_t Cyan = rgb(0, L, L);
+
+  // the words, then their colours; the symbols go on top of lit, not of words
+  words(tm.Hour, tm.Minute, *config.phrase, out.words);
+  out.lit = out.words;
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    out.pixel[p] = out.lit.test(p) ? FOREGROUNDCOLOR : BACKGROUNDCOLOR;
+  };
+
+  // status symbols
+  setSymbol(out, symbolWiFi, (status & STATUS_WIFI) ? WIFICONNECTED : WIFIDISCONNECTED);
+  setSymbol(out, symbolTime, (status & STATUS_TIME) ? NTP_SET : NTP_NOT_SET);
+  if (!(status & STATUS_WIFI) || !(status & STATUS_TIME) || (status & STATUS_WARNING)) {
+    setSymbol(out, symbolWarning, WARNING_COLOR);
+  };
+
+  // sun and moon, where the clock is
+  SunRise sun;
+  sun.calculate(device.latitude, device.longitude, utc);
+  if (sun.isVisible) {
+    setSymbol(out, symbolSun, SUN_COLOR);
+  };
+  MoonRise moon;
+  moon.calculate(device.latitude, device.longitude, utc);
+  if (moon.isVisible) {
+    setSymbol(out, symbolMoon, MOON_COLOR);
+  };
+
+  // holidays, by the local date; two on one day: both symbols, the later name
+  int y = tmYearToCalendar(tm.Year);
+  int m = tm.Month;
+  int d = tm.Day;
+  out.holiday = "none";
+  if (m == config.birthdayMonth && d == config.birthdayDay) {
+    setSymbol(out, symbolLove, THECOLOROFLOVE);
+    out.holiday = "birthday";
+  };
+  if (easter(y, m, d)) {
+    setSymbol(out, symbolEaster, EASTERCOLOR);
+    out.holiday = "easter";
+  };
+  if (m == 10 && d == 31) {
+    // the ghost changes colour every minute, LOL
+    const uint32_t ghost[] = { HALLOWEEN_0, HALLOWEEN_1, HALLOWEEN_2, HALLOWEEN_3 };
+    setSymbol(out, symbolHalloween, ghost[abs((tm.Minute % 6) - 3)]);
+    out.holiday = "halloween";
+  };
+  if (m == 12 && (d == 25 || d == 26)) {
+    setSymbol(out, symbolChristmas, CHRISTMASCOLOR);
+    out.holiday = "christmas";
+  };
+};
+
+// shared by the threads working on one renderBatch()
+struct FaceBatch {
+  const FaceRenderer::Job *jobs;
+  FaceRenderer::Frame *out;
+  int n;
+  std::atomic<int> next;
+};
+
+// the worker pool: started as batches ask for more threads, kept for good (and never
+// destroyed: the workers wait on it until the process ends)
+struct FacePool {
+  std::mutex batch;                        // one batch at a time
+  std::mutex lock;                         // the rest
+  std::condition_variable work;            // a new round is out
+  std::condition_variable done;            // the last helper of the round is done
+  FaceBatch *current = NULL;
+  uint32_t round = 0;                      // one per batch
+  int helpers = 0;                         // workers 0..helpers - 1 help in this round
+  int busy = 0;                            // helpers not done yet
+  int started = 0;
+};
+
+static FacePool &facePool() {
+  static FacePool *pool = new FacePool();  // first batch only
+  return *pool;
+}
+
+static void batchWork(FaceBatch *batch) {
+  for (;;) {
+    int first = batch->next.fetch_add(FACE_BATCH_CHUNK);
+    if (first >= batch->n) {
+      return;
+    };
+    int last = first + FACE_BATCH_CHUNK < batch->n ? first + FACE_BATCH_CHUNK : batch->n;
+    for (int i = first; i < last; i++) {
+      FaceRenderer::render(batch->jobs[i].utc, *batch->jobs[i].device, batch->jobs[i].status, batch->out[i]);
+    };
+  };
+}
+
+// waits for a round it's asked to help with, helps, says so
+static void poolWorker(int id, uint32_t round) {
+  FacePool &pool = facePool();
+  for (;;) {
+    FaceBatch *batch;
+    {
+      std::unique_lock<std::mutex> lock(pool.lock);
+      while (pool.round == round) {
+        pool.work.wait(lock);
+      };
+      round = pool.round;
+      if (id >= pool.helpers) {
+        continue;
+      };
+      batch = pool.current;
+    }
+    batchWork(batch);
+    std::lock_guard<std::mutex> lock(pool.lock);
+    if (--pool.busy == 0) {
+      pool.done.notify_one();
+    };
+  };
+}
+
+// out[i] for jobs[i]; the caller is one of the threads, returns when all are done
+void FaceRenderer::renderBatch(const Job *jobs, int n, Frame *out, int threads) {
+  if (threads > FACE_BATCH_THREADS) {
+    threads = FACE_BATCH_THREADS;
+  };
+  if (threads < 1) {
+    threads = 1;
+  };
+  FacePool &pool = facePool();
+  std::lock_guard<std::mutex> one(pool.batch);
+  if (pool.started < threads - 1) {
+#ifdef ESP_PLATFORM
+    // std::thread is a pthread is a FreeRTOS task, with a 3k stack unless told otherwise
+    esp_pthread_cfg_t cfg = esp_pthread_get_default_config();
+    cfg.stack_size = FACE_WORKER_STACK;
+    esp_pthread_set_cfg(&cfg);
+#endif
+    std::lock_guard<std::mutex> lock(pool.lock);
+    while (pool.started < threads - 1) {
+      std::thread(poolWorker, pool.started, pool.round).detach();
+      pool.started++;
+    };
+  };
+
+  FaceBatch batch;
+  batch.jobs = jobs;
+  batch.out = out;
+  batch.n = n;
+  batch.next = 0;
+  {
+    std::lock_guard<std::mutex> lock(pool.lock);
+    pool.current = &batch;
+    pool.helpers = threads - 1;
+    pool.busy = threads - 1;
+    pool.round++;
+  }
+  pool.work.notify_all();
+  batchWork(&batch);
+  std::unique_lock<std::mutex> lock(pool.lock);
+  while (pool.busy > 0) {
+    pool.done.wait(lock);
+  };
+};
+
+// the letters of Frame::words in reading order, a space wherever there's a gap;
+// umlauts as UTF-8 (lit has the symbols too, and some of those are letters)
+void FaceRenderer::phrase(const FrameMask &words, char *out, size_t len) {
+  size_t n = 0;
+  int last = -2;
+  for (int p = 0; p < NEO_PIXELS && n + 3 < len; p++) {
+    int led = FACE(p / Face::COL_COUNT, p % Face::COL_COUNT);
+    char c = wordClockString[led];
+    bool umlaut = (c == 'a' || c == 'o' || c == 'u');
+    if (!words.test(led) || !((c >= 'A' && c <= 'Z') || umlaut)) {
+      continue;  // dark, or a symbol
+    };
+    if (n > 0 && (p != last + 1 || p % Face::COL_COUNT == 0)) {
+      out[n++] = ' ';
+    };
+    if (umlaut) {
+      out[n++] = '\xC3';
+      out[n++] = (c == 'a') ? '\x84' : (c == 'o') ? '\x96' : '\x9C';
+    } else {
+      out[n++] = c;
+    };
+    last = p;
+  };
+  out[n] = '\0';
+};
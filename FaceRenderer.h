@@ -0,0 +1,89 @@
+#ifndef FACE_RENDERER_H
+#define FACE_RENDERER_H
+
+/* The face as a pure function: (UTC instant, timezone, location, config) -> frame.
+ *
+ * Everything that decides what the face shows lives here: the phrase for the minute,
+ * the day/night level and palette, sun and moon, the status symbols and the holidays.
+ * No strip, no Serial, no WiFi: WordClock hands the frame to the LEDs, and the same
+ * code can render the face of any other clock (its own timezone, place and config)
+ * for a preview, e.g. a dashboard of every deployed clock, or a whole day in a batch.
+ *
+ * The words are FrameMasks built at compile time from the pixel lists in FaceLayout.h,
+ * so the bulk of a face is "IT IS" | minute words | hour, a few ORs over
+ * FRAME_MASK_WORDS words; the colours are filled in from the mask afterwards. Colours
+ * are palette levels before gamma, as DITHER wants them; without DITHER, WordClock
+ * puts them through gamma8[] on the way to the strip (a preview would do the same).
+ *
+ * This is a library of its own: it needs FaceLayout.h, PhraseMode and the TimeLib,
+ * Timezone, SunRise and MoonRise libraries, not WordClock.h, the Arduino core or
+ * anything with a radio in it, so it builds for a host as it is.
+ *
+ * renderBatch() renders many jobs (instant + device + status) on a pool of worker
+ * threads (std::thread, so it runs on the ESP32 and on a host alike), started by the
+ * first batch that wants them and kept waiting on a condition variable after that.
+ * The caller works too; everybody takes chunks of FACE_BATCH_CHUNK jobs off a shared
+ * counter until none are left. Timezone caches the DST switch times inside the
+ * object, so every render works on its own copy and devices can share one Timezone
+ * across threads.
+ *
+ * benchmark() (DEBUG, Serial 'r', in FaceBenchmark.cpp) renders a day, minute by
+ * minute, and prints frames per second: the words alone, one full frame at a time,
+ * and spread over the workers, with what starting the workers took on its own line.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "FaceLayout.h"
+#include "FrameMask.h"
+#include "PhraseMode.h"
+
+class Timezone;                 // https://github.com/JChristensen/Timezone
+class Print;                    // benchmark() only
+
+#define FACE_BATCH_CHUNK 32     // jobs a worker takes at a time
+#define FACE_BATCH_THREADS 8    // most threads a batch runs on, the caller included
+#define FACE_WORKER_STACK 8192  // bytes, sun and moon need a bit (ESP32, pthread)
+#define FACE_PHRASE_LEN 96      // phrase(): lit words, UTF-8
+
+class FaceRenderer {
+public:
+  struct Config {
+    const PhraseMode *phrase;
+    int brightness;             // peak of the day/night curve, 0..255
+    int contrast;               // how much darker the night is, 0..255
+    uint8_t birthdayMonth;      // love heart on this day, 0: none
+    uint8_t birthdayDay;
+    int ambient;                // share of brightness from a light sensor 0..255, -1: by the time
+  };
+  struct Device {
+    Timezone *tz;
+    float latitude;
+    float longitude;
+    Config config;
+  };
+  // live state that's not a function of the time, for the status symbols
+  enum { STATUS_WIFI = 0x01, STATUS_TIME = 0x02, STATUS_WARNING = 0x04 };
+  struct Job {
+    time_t utc;
+    const Device *device;
+    uint8_t status;
+  };
+  struct Frame {
+    FrameMask lit;              // not BACKGROUNDCOLOR
+    FrameMask words;            // the words alone, no symbols (some sit on letters)
+    uint32_t pixel[NEO_PIXELS]; // 0x00RRGGBB palette levels, before gamma
+    int level;
+    const char *holiday;        // "none", "birthday", "easter", "halloween", "christmas"
+  };
+  static void render(time_t utc, const Device &device, uint8_t status, Frame &out);
+  static void renderBatch(const Job *jobs, int n, Frame *out, int threads);
+  static void words(int hour, int minute, const PhraseMode &phrase, FrameMask &out);
+  static int level(int hour, int minute, const Config &config);
+  static bool easter(int year, int month, int day);
+  static void phrase(const FrameMask &words, char *out, size_t len);
+  static void benchmark(Print &out, const Device &device);  // DEBUG builds
+};
+
+#endif
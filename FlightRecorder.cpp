@@ -0,0 +1,226 @@
+/*
+ * This is FlightRecorder.cpp
+ */
+
+#include "WordClock.h"          // FLIGHT_RECORDER switch, FIRMWARE_VERSION
+#ifdef FLIGHT_RECORDER
+#include <esp_system.h>         // esp_reset_reason(), esp_register_shutdown_handler()
+
+#define FLIGHT_MAGIC 0x464C5452  // "FLTR"
+#define FLIGHT_MASK_BYTES ((NEO_PIXELS + 7) / 8)
+static_assert(FLIGHT_MASK_BYTES <= sizeof(((FlightRecorder::Record *)0)->data), "frame mask doesn't fit a record");
+#define FLIGHT_SLOTS (FLIGHT_SECTORS * FLIGHT_SECTOR_SIZE / sizeof(FlightRecorder::Record))
+#define FLIGHT_SLOTS_PER_SECTOR (FLIGHT_SECTOR_SIZE / sizeof(FlightRecorder::Record))
+
+// the RAM ring lives in RTC slow memory, which a panic or watchdog reset leaves alone
+struct FlightRing {
+  uint32_t magic;
+  uint32_t seq;    // last seq handed out
+  uint32_t head;   // next slot to write
+  FlightRecorder::Record records[FLIGHT_RAM_RECORDS];
+};
+static RTC_NOINIT_ATTR FlightRing ring;
+
+// for the shutdown handler, there is only one recorder
+static FlightRecorder *recorder = NULL;
+
+FlightRecorder::FlightRecorder() {
+  _time = NULL;
+  _partition = NULL;
+  _flashSlot = 0;
+  _flashSeq = 0;
+  _lastFrame.clear();
+  _lastKeyframe = 0;
+};
+
+void FlightRecorder::begin(TimeBase &time) {
+  _time = &time;
+  _partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_SPIFFS, NULL);
+  if (_partition != NULL && _partition->size < FLIGHT_SECTORS * FLIGHT_SECTOR_SIZE) {
+    _partition = NULL;  // too small, RAM only
+  };
+  _findFlashEnd();
+
+  // power-on leaves RTC memory random; anything else (panic, WDT, restart) keeps it
+  if (ring.magic != FLIGHT_MAGIC || ring.head >= FLIGHT_RAM_RECORDS) {
+    memset(&ring, 0, sizeof(ring));
+    ring.magic = FLIGHT_MAGIC;
+    ring.seq = _flashSeq;
+  };
+  if (ring.seq < _flashSeq) {
+    ring.seq = _flashSeq;
+  };
+  // whatever the last run didn't get to write, write it now
+  flush();
+
+  Record *r = _append(BOOT);
+  r->data[0] = (uint8_t)esp_reset_reason();
+  strncpy((char *)&r->data[1], FIRMWARE_VERSION, sizeof(r->data) - 1);
+
+  recorder = this;
+  esp_register_shutdown_handler(&_shutdown);
+};
+
+// frame changes as XOR against the previous frame, a full one now and then
+void FlightRecorder::frame(const FrameMask &f) {
+  if (f == _lastFrame && _lastKeyframe != 0) {
+    return;
+  };
+  time_t now_s = _time->utc();
+  Record *r;
+  if (_lastKeyframe == 0 || now_s - _lastKeyframe >= FLIGHT_KEYFRAME_INTERVAL) {
+    r = _append(KEYFRAME);
+    memcpy(r->data, f.w, FLIGHT_MASK_BYTES);
+    _lastKeyframe = now_s;
+  } else {
+    FrameMask diff = f ^ _lastFrame;
+    r = _append(FRAME);
+    memcpy(r->data, diff.w, FLIGHT_MASK_BYTES);
+  };
+  _lastFrame = f;
+};
+
+void FlightRecorder::wifi(int status, int rssi) {
+  Record *r = _append(WIFI);
+  r->data[0] = (uint8_t)status;
+  r->data[1] = (uint8_t)(int8_t)rssi;
+};
+
+void FlightRecorder::ntp(int32_t offset_ms, int32_t delay_ms) {
+  Record *r = _append(NTP);
+  memcpy(&r->data[0], &offset_ms, 4);
+  memcpy(&r->data[4], &delay_ms, 4);
+};
+
+void FlightRecorder::watchdog(uint32_t loop_ms) {
+  Record *r = _append(WATCHDOG);
+  memcpy(&r->data[0], &loop_ms, 4);
+};
+
+void FlightRecorder::note(const char *text) {
+  Record *r = _append(NOTE);
+  strncpy((char *)r->data, text, sizeof(r->data));
+};
+
+// next slot in the RAM ring, stamped and zeroed; flushes when enough are waiting
+FlightRecorder::Record *FlightRecorder::_append(Type type) {
+  if (ring.seq - _flashSeq >= FLIGHT_FLUSH_RECORDS) {
+    flush();
+  };
+  Record *r = &ring.records[ring.head];
+  memset(r, 0, sizeof(*r));
+  int64_t t = _time->utc_ms();
+  r->seq = ++ring.seq;
+  r->utc = (uint32_t)(t / 1000);
+  r->ms = (uint16_t)(t % 1000);
+  r->type = type;
+  ring.head = (ring.head + 1) % FLIGHT_RAM_RECORDS;
+  return r;
+};
+
+// copy everything newer than what's in flash, oldest first
+void FlightRecorder::flush() {
+  if (_partition == NULL) {
+    return;
+  };
+  for (int i = 0; i < FLIGHT_RAM_RECORDS; i++) {
+    const Record &r = ring.records[(ring.head + i) % FLIGHT_RAM_RECORDS];
+    if (r.seq > _flashSeq && r.seq <= ring.seq) {
+      if (!_write(r)) {
+        return;
+      };
+    };
+  };
+};
+
+// append one record to the flash ring, erasing a sector when we first get to it
+bool FlightRecorder::_write(const Record &r) {
+  uint32_t offset = _flashSlot * sizeof(Record);
+  if (offset % FLIGHT_SECTOR_SIZE == 0) {
+    if (esp_partition_erase_range(_partition, offset, FLIGHT_SECTOR_SIZE) != ESP_OK) {
+      return false;
+    };
+  };
+  if (esp_partition_write(_partition, offset, &r, sizeof(r)) != ESP_OK) {
+    return false;
+  };
+  _flashSlot = (_flashSlot + 1) % FLIGHT_SLOTS;
+  _flashSeq = r.seq;
+  return true;
+};
+
+// find the sector with the newest records, then the first free slot in it
+void FlightRecorder::_findFlashEnd() {
+  _flashSlot = 0;
+  _flashSeq = 0;
+  if (_partition == NULL) {
+    return;
+  };
+  int newest = -1;
+  for (int s = 0; s < FLIGHT_SECTORS; s++) {
+    uint32_t seq;
+    esp_partition_read(_partition, s * FLIGHT_SECTOR_SIZE, &seq, sizeof(seq));
+    if (seq != 0xFFFFFFFF && seq >= _flashSeq) {
+      _flashSeq = seq;
+      newest = s;
+    };
+  };
+  if (newest < 0) {
+    return;  // empty (or never used), start at slot 0
+  };
+  _flashSlot = newest * FLIGHT_SLOTS_PER_SECTOR;
+  for (uint32_t i = 0; i < FLIGHT_SLOTS_PER_SECTOR; i++) {
+    Record r;
+    esp_partition_read(_partition, (_flashSlot + i) * sizeof(Record), &r, sizeof(r));
+    if (r.seq == 0xFFFFFFFF) {
+      _flashSlot += i;
+      return;
+    };
+    _flashSeq = r.seq;
+  };
+  _flashSlot = (_flashSlot + FLIGHT_SLOTS_PER_SECTOR) % FLIGHT_SLOTS;  // sector full, next one
+};
+
+static void _hexRecord(Print &out, const FlightRecorder::Record &r) {
+  const uint8_t *b = (const uint8_t *)&r;
+  char line[3 + 2 * sizeof(r) + 1];
+  strcpy(line, "FR ");
+  for (size_t i = 0; i < sizeof(r); i++) {
+    snprintf(&line[3 + 2 * i], 3, "%02x", b[i]);
+  };
+  out.println(line);
+}
+
+// the whole log, oldest first: flash ring, then whatever is still only in RAM
+void FlightRecorder::dump(Print &out) {
+  out.println("FR begin");
+  if (_partition != NULL) {
+    for (uint32_t i = 0; i < FLIGHT_SLOTS; i++) {
+      Record r;
+      esp_partition_read(_partition, ((_flashSlot + i) % FLIGHT_SLOTS) * sizeof(Record), &r, sizeof(r));
+      if (r.seq != 0xFFFFFFFF) {
+        _hexRecord(out, r);
+      };
+      if (i % 256 == 0) {
+        esp_task_wdt_reset();  // 8000 lines at 9600 baud take a while
+      };
+    };
+  };
+  for (int i = 0; i < FLIGHT_RAM_RECORDS; i++) {
+    const Record &r = ring.records[(ring.head + i) % FLIGHT_RAM_RECORDS];
+    if (r.seq > _flashSeq && r.seq <= ring.seq) {
+      _hexRecord(out, r);
+    };
+  };
+  out.println("FR end");
+};
+
+// esp_restart() (e.g. after OTA): get the RAM ring into flash first
+void FlightRecorder::_shutdown() {
+  if (recorder != NULL) {
+    recorder->note("restart");
+    recorder->flush();
+  };
+};
+
+#endif  // FLIGHT_RECORDER
@@ -0,0 +1,78 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+/* Flight recorder (#define FLIGHT_RECORDER in WordClock.h).
+ *
+ * Nobody has a Serial monitor attached at 3am, so the clock keeps its own log of
+ * what happened: frame changes (as XOR delta masks, with a full keyframe after
+ * every boot and every hour), WiFi state changes, NTP samples, boots with their
+ * reset reason, and loops that came close to the watchdog.
+ *
+ * Records are 32 bytes and go into a RAM ring in RTC memory first. RTC memory
+ * survives a panic or a watchdog reset, so whatever hadn't made it to flash yet is
+ * written out on the next boot. Otherwise the ring is flushed every
+ * FLIGHT_FLUSH_RECORDS records, and on an orderly restart (OTA).
+ *
+ * In flash the records are appended to a log ring of FLIGHT_SECTORS sectors at the
+ * start of the (otherwise unused) "spiffs" data partition. A sector is erased only
+ * when the log wraps around to it, so every sector wears the same.
+ *
+ * Send 'd' on the Serial port to dump the log as "FR <64 hex>" lines, then
+ *   python3 tools/flight_decode.py serial.log
+ * replays it, frames drawn with wordClockString.
+ */
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "TimeBase.h"
+#include "FrameMask.h"
+
+#define FLIGHT_RAM_RECORDS 64       // RTC RAM ring, 2 KB
+#define FLIGHT_FLUSH_RECORDS 32     // flush to flash when this many are waiting
+#define FLIGHT_SECTORS 64           // 256 KB of flash, ~8000 records, ~5 days of minute flips
+#define FLIGHT_SECTOR_SIZE 4096
+#define FLIGHT_KEYFRAME_INTERVAL 3600  // s between full frames, so a wrapped log still decodes
+
+class FlightRecorder {
+public:
+  enum Type : uint8_t {
+    BOOT = 1,       // data[0] reset reason, data[1..] firmware version
+    KEYFRAME = 2,   // data[0..17] full 144 bit frame mask
+    FRAME = 3,      // data[0..17] XOR against the previous frame
+    WIFI = 4,       // data[0] wl_status_t, data[1] RSSI (int8)
+    NTP = 5,        // data[0..3] offset ms, data[4..7] round trip ms (int32)
+    WATCHDOG = 6,   // data[0..3] loop() duration ms, WDT_TIMEOUT is 30 s
+    NOTE = 7        // data[] short text
+  };
+  struct Record {
+    uint32_t seq;   // 0xFFFFFFFF is an erased flash slot
+    uint32_t utc;
+    uint16_t ms;
+    uint8_t type;
+    uint8_t reserved;
+    uint8_t data[20];
+  } __attribute__((packed));
+
+  FlightRecorder();
+  void begin(TimeBase &time);
+  void frame(const FrameMask &f);
+  void wifi(int status, int rssi);
+  void ntp(int32_t offset_ms, int32_t delay_ms);
+  void watchdog(uint32_t loop_ms);
+  void note(const char *text);
+  void flush();
+  void dump(Print &out);
+private:
+  TimeBase *_time;
+  const esp_partition_t *_partition;
+  uint32_t _flashSlot;      // next free record slot in the flash ring
+  uint32_t _flashSeq;       // highest seq already in flash
+  FrameMask _lastFrame;
+  time_t _lastKeyframe;
+  Record *_append(Type type);
+  bool _write(const Record &r);
+  void _findFlashEnd();
+  static void _shutdown();
+};
+
+#endif
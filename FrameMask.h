@@ -0,0 +1,68 @@
+#ifndef FRAME_MASK_H
+#define FRAME_MASK_H
+
+/* One bit per LED (NEO_PIXELS): which pixels are lit (not BACKGROUNDCOLOR) on the face.
+ * Cheap to compare and XOR, so a frame change is just the set of toggled bits. The
+ * operators are plain loops over FRAME_MASK_WORDS words, which a compiler unrolls (and
+ * vectorises, on a host) - a face is a handful of ORs.
+ */
+
+#include <stdint.h>
+
+#define FRAME_MASK_WORDS ((NEO_PIXELS + 31) / 32)  // 5 x 32 = 160 >= 144 bits for 12x12
+
+struct FrameMask {
+  uint32_t w[FRAME_MASK_WORDS];
+
+  void clear() {
+    for (int i = 0; i < FRAME_MASK_WORDS; i++) w[i] = 0;
+  }
+  void set(int p) {
+    w[p >> 5] |= (1UL << (p & 31));
+  }
+  void reset(int p) {
+    w[p >> 5] &= ~(1UL << (p & 31));
+  }
+  bool test(int p) const {
+    return (w[p >> 5] >> (p & 31)) & 1;
+  }
+  bool operator==(const FrameMask &o) const {
+    for (int i = 0; i < FRAME_MASK_WORDS; i++) {
+      if (w[i] != o.w[i]) return false;
+    }
+    return true;
+  }
+  bool operator!=(const FrameMask &o) const {
+    return !(*this == o);
+  }
+  FrameMask operator^(const FrameMask &o) const {
+    FrameMask r;
+    for (int i = 0; i < FRAME_MASK_WORDS; i++) r.w[i] = w[i] ^ o.w[i];
+    return r;
+  }
+  FrameMask &operator|=(const FrameMask &o) {
+    for (int i = 0; i < FRAME_MASK_WORDS; i++) w[i] |= o.w[i];
+    return *this;
+  }
+  FrameMask operator|(const FrameMask &o) const {
+    FrameMask r;
+    for (int i = 0; i < FRAME_MASK_WORDS; i++) r.w[i] = w[i] | o.w[i];
+    return r;
+  }
+  int count() const {
+    int n = 0;
+    for (int i = 0; i < FRAME_MASK_WORDS; i++) n += __builtin_popcount(w[i]);
+    return n;
+  }
+};
+
+// C++11 has no std::index_sequence, this hands out 0..N-1 for the mask words, so a
+// constexpr function can build a FrameMask one word at a time:
+//   FrameMask{ { bits(W)... } } with W from FrameMaskMakeIndex<FRAME_MASK_WORDS>::type
+template <int... W> struct FrameMaskIndex {};
+template <int N, int... W> struct FrameMaskMakeIndex : FrameMaskMakeIndex<N - 1, N - 1, W...> {};
+template <int... W> struct FrameMaskMakeIndex<0, W...> {
+  typedef FrameMaskIndex<W...> type;
+};
+
+#endif
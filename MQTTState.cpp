@@ -0,0 +1,158 @@
+/*
+ * This is MQTTState.cpp
+ */
+
+#include "WordClock.h"          // MQTT_STATE switch
+#ifdef MQTT_STATE
+
+#define MQTT_TOPIC_BRIGHTNESS MQTT_TOPIC "/set/brightness"
+#define MQTT_TOPIC_EFFECT MQTT_TOPIC "/set/effect"
+
+MQTTState::MQTTState() {
+  _client = NULL;
+  _task = NULL;
+  memset(&_last, 0, sizeof(_last));
+  memset(&_pending, 0, sizeof(_pending));
+  _haveLast = false;
+  _dirty = false;
+  _connected = false;
+  _brightness = -1;
+  _effect[0] = '\0';
+  _effectPending = false;
+  _payload[0] = '\0';
+};
+
+// call once WiFi is up; the client allocates here, never again in publish()
+void MQTTState::begin() {
+  esp_mqtt_client_config_t config;
+  memset(&config, 0, sizeof(config));
+  config.uri = MQTT_BROKER_URL;
+  config.client_id = HOSTNAME;
+  config.lwt_topic = MQTT_TOPIC "/status";
+  config.lwt_msg = "offline";
+  config.lwt_retain = 1;
+  config.keepalive = 60;
+  _client = esp_mqtt_client_init(&config);
+  if (_client == NULL) {
+    return;
+  };
+  xTaskCreatePinnedToCore(_taskMain, "mqtt_state", MQTT_TASK_STACK, this, 1, &_task, MQTT_TASK_CORE);
+  esp_mqtt_client_register_event(_client, (esp_mqtt_event_id_t)ESP_EVENT_ANY_ID, _event, this);
+  esp_mqtt_client_start(_client);
+};
+
+// at the minute flip: queue the state if it changed, replacing anything still queued
+void MQTTState::publish(const Values &v) {
+  if (_haveLast && !_changed(v, _last)) {
+    return;
+  };
+  _last = v;
+  _haveLast = true;
+  portENTER_CRITICAL(&_lock);
+  _pending = v;
+  portEXIT_CRITICAL(&_lock);
+  _dirty = true;
+  if (_task != NULL) {
+    xTaskNotifyGive(_task);
+  };
+};
+
+// new peak brightness from MQTT_TOPIC/set/brightness, once
+bool MQTTState::takeBrightness(int &brightness) {
+  int b = _brightness;
+  if (b < 0) {
+    return false;
+  };
+  _brightness = -1;
+  brightness = b;
+  return true;
+};
+
+// the last command from MQTT_TOPIC/set/effect, once
+bool MQTTState::takeEffect(char *effect, size_t len) {
+  if (!_effectPending) {
+    return false;
+  };
+  portENTER_CRITICAL(&_lock);
+  strncpy(effect, _effect, len - 1);
+  effect[len - 1] = '\0';
+  _effectPending = false;
+  portEXIT_CRITICAL(&_lock);
+  return true;
+};
+
+bool MQTTState::_changed(const Values &a, const Values &b) {
+  return strcmp(a.phrase, b.phrase) != 0 || a.level != b.level || a.brightness != b.brightness
+         || abs(a.offset_ms - b.offset_ms) >= MQTT_OFFSET_DEADBAND || abs(a.rssi - b.rssi) >= MQTT_RSSI_DEADBAND
+         || strcmp(a.holiday, b.holiday) != 0;
+};
+
+void MQTTState::_taskMain(void *arg) {
+  MQTTState *self = (MQTTState *)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (self->_connected && self->_dirty) {
+      self->_dirty = false;
+      self->_send();
+    };
+  };
+};
+
+void MQTTState::_send() {
+  Values v;
+  portENTER_CRITICAL(&_lock);
+  v = _pending;
+  portEXIT_CRITICAL(&_lock);
+  // the phrase is letters and spaces only, nothing to escape
+  int n = snprintf(_payload, sizeof(_payload),
+                   "{\"phrase\":\"%s\",\"level\":%d,\"brightness\":%d,\"offset_ms\":%ld,\"rssi\":%d,\"holiday\":\"%s\"}",
+                   v.phrase, v.level, v.brightness, (long)v.offset_ms, v.rssi, v.holiday);
+  if (n <= 0 || n >= (int)sizeof(_payload)) {
+    return;
+  };
+  if (esp_mqtt_client_publish(_client, MQTT_TOPIC "/state", _payload, n, 0, 1) < 0) {
+    _dirty = true;  // try again on the next change or reconnect
+  };
+};
+
+// runs in the esp-mqtt task
+void MQTTState::_event(void *arg, esp_event_base_t base, int32_t id, void *data) {
+  MQTTState *self = (MQTTState *)arg;
+  esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)data;
+  switch (id) {
+    case MQTT_EVENT_CONNECTED:
+      self->_connected = true;
+      esp_mqtt_client_publish(self->_client, MQTT_TOPIC "/status", "online", 0, 0, 1);
+      esp_mqtt_client_subscribe(self->_client, MQTT_TOPIC "/set/#", 0);
+      // the broker may have missed changes (or never seen us): send the latest state
+      if (self->_haveLast) {
+        self->_dirty = true;
+        xTaskNotifyGive(self->_task);
+      };
+      break;
+    case MQTT_EVENT_DISCONNECTED:
+      self->_connected = false;
+      break;
+    case MQTT_EVENT_DATA:
+      // topic and data are not 0 terminated
+      if (event->topic_len == (int)strlen(MQTT_TOPIC_BRIGHTNESS) && strncmp(event->topic, MQTT_TOPIC_BRIGHTNESS, event->topic_len) == 0) {
+        char number[8];
+        int len = event->data_len < (int)sizeof(number) - 1 ? event->data_len : (int)sizeof(number) - 1;
+        memcpy(number, event->data, len);
+        number[len] = '\0';
+        self->_brightness = constrain(atoi(number), 0, 255);
+      } else if (event->topic_len == (int)strlen(MQTT_TOPIC_EFFECT) && strncmp(event->topic, MQTT_TOPIC_EFFECT, event->topic_len) == 0) {
+        int len = event->data_len < MQTT_EFFECT_LEN - 1 ? event->data_len : MQTT_EFFECT_LEN - 1;
+        portENTER_CRITICAL(&self->_lock);
+        memcpy(self->_effect, event->data, len);
+        self->_effect[len] = '\0';
+        self->_effectPending = true;
+        portEXIT_CRITICAL(&self->_lock);
+      };
+      break;
+    default:
+      break;
+  };
+};
+
+#endif  // MQTT_STATE
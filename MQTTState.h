@@ -0,0 +1,83 @@
+#ifndef MQTT_STATE_H
+#define MQTT_STATE_H
+
+/* Clock state for the home automation, over MQTT (#define MQTT_STATE in WordClock.h).
+ *
+ * Published, retained, as one JSON object on MQTT_TOPIC/state:
+ *
+ *   {"phrase":"ES ISCH FÜF AB DRÜ","level":142,"brightness":196,"offset_ms":-3,
+ *    "rssi":-61,"holiday":"none"}
+ *
+ * loop() hands over the state at every minute flip. Only if something changed (RSSI
+ * and offset with a deadband, they wobble) is it queued, and the queue holds one
+ * state: whatever changed in between goes out as one publish. While the broker is
+ * away nothing piles up, the latest state goes out on reconnect. The JSON is built
+ * with snprintf() into a buffer that's part of the object, in our own task on core
+ * 0, so loop() neither formats nor waits for the network.
+ *
+ * Subscribed, handled in loop() through takeBrightness() / takeEffect():
+ *
+ *   MQTT_TOPIC/set/brightness   0..255, peak brightness of the day/night curve
+ *   MQTT_TOPIC/set/effect       clock | rainbow | chase | message <text> | phrase <mode>
+ *
+ * MQTT_TOPIC/status is "online", or "offline" (last will) when the clock drops off.
+ *
+ * Uses the esp-mqtt client that comes with the ESP32 core (mqtt_client.h), which
+ * runs its own task for the connection. To test with a Mosquitto on the laptop:
+ *   mosquitto -v
+ *   mosquitto_sub -v -t 'wordclock/#'
+ *   mosquitto_pub -t wordclock/WORDCLOCK/set/effect -m 'message HOI'
+ * with MQTT_BROKER_URL (utils.h) pointing at it. tools/mqtt_check.py does the same
+ * unattended: it sends set/brightness and set/effect and checks that the state is
+ * retained, follows the commands, and comes exactly once per minute flip.
+ */
+
+#include <Arduino.h>
+#include <mqtt_client.h>        // https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/protocols/mqtt.html
+#include "utils.h"              // HOSTNAME, MQTT_BROKER_URL
+#include "FaceRenderer.h"       // FACE_PHRASE_LEN
+
+#define MQTT_TOPIC "wordclock/" HOSTNAME
+#define MQTT_PHRASE_LEN FACE_PHRASE_LEN
+#define MQTT_PAYLOAD_LEN 256
+#define MQTT_EFFECT_LEN 80          // "message " + MESSAGE_MAX_LEN
+#define MQTT_RSSI_DEADBAND 3        // dB
+#define MQTT_OFFSET_DEADBAND 5      // ms
+#define MQTT_TASK_STACK 3072
+#define MQTT_TASK_CORE 0
+
+class MQTTState {
+public:
+  struct Values {
+    char phrase[MQTT_PHRASE_LEN];
+    int level;              // LED level after the day/night curve, 0..255
+    int brightness;         // peak of the curve
+    int32_t offset_ms;      // last correction from NTP
+    int rssi;
+    const char *holiday;    // "none", "birthday", "easter", "halloween", "christmas"
+  };
+  MQTTState();
+  void begin();
+  void publish(const Values &v);
+  bool takeBrightness(int &brightness);
+  bool takeEffect(char *effect, size_t len);
+private:
+  esp_mqtt_client_handle_t _client;
+  TaskHandle_t _task;
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+  Values _last;             // loop() side: last state handed over
+  bool _haveLast;
+  Values _pending;          // task side, under _lock
+  volatile bool _dirty;
+  volatile bool _connected;
+  volatile int _brightness; // -1: no command
+  char _effect[MQTT_EFFECT_LEN];
+  volatile bool _effectPending;
+  char _payload[MQTT_PAYLOAD_LEN];
+  static bool _changed(const Values &a, const Values &b);
+  static void _taskMain(void *arg);
+  static void _event(void *arg, esp_event_base_t base, int32_t id, void *data);
+  void _send();
+};
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * This is Message.cpp
+ */
+
+#include "WordClock.h"          // MESSAGE switch, wordClockString, Face
+#ifdef MESSAGE
+
+#define MESSAGE_END -1
+#define MESSAGE_SPACE -2
+#define MESSAGE_SKIP -3
+
+// letter on the face at reading position p (row by row, left to right)
+static constexpr char gridLetter(int p) {
+  return wordClockString[FACE(p / Face::COL_COUNT, p % Face::COL_COUNT)];
+}
+
+// the face spells Ä, Ö, Ü as lower case a, o, u; they light up for A, O, U too
+static constexpr char foldLetter(char c) {
+  return c == 'a' ? 'A' : c == 'o' ? 'O' : c == 'u' ? 'U' : c;
+}
+
+// bits [bit..31] of mask word 'word' for letter l
+static constexpr uint32_t letterBits(char l, int word, int bit) {
+  return bit == 32 ? 0
+       : ((word * 32 + bit < NEO_PIXELS && foldLetter(gridLetter(word * 32 + bit)) == l) ? (1UL << bit) : 0)
+           | letterBits(l, word, bit + 1);
+}
+
+template <int... W>
+static constexpr FrameMask letterMask(char l, FrameMaskIndex<W...>) {
+  return FrameMask{ { letterBits(l, W, 0)... } };
+}
+
+#define LETTER(l) letterMask(l, FrameMaskMakeIndex<FRAME_MASK_WORDS>::type())
+
+// letter -> reading positions, in flash; nothing of this runs on the clock
+static constexpr FrameMask letterIndex[26] = {
+  LETTER('A'), LETTER('B'), LETTER('C'), LETTER('D'), LETTER('E'), LETTER('F'), LETTER('G'),
+  LETTER('H'), LETTER('I'), LETTER('J'), LETTER('K'), LETTER('L'), LETTER('M'), LETTER('N'),
+  LETTER('O'), LETTER('P'), LETTER('Q'), LETTER('R'), LETTER('S'), LETTER('T'), LETTER('U'),
+  LETTER('V'), LETTER('W'), LETTER('X'), LETTER('Y'), LETTER('Z')
+};
+static_assert(letterIndex['H' - 'A'].w[0] & 1UL << 6, "letter index doesn't match the face");
+
+// reading position -> LED
+static constexpr int stripIndex(int p) {
+  return FACE(p / Face::COL_COUNT, p % Face::COL_COUNT);
+}
+
+// pixels for as much of text as fits, returns the number of chars used (whole words)
+int Message::compose(const char *text, FrameMask &out) {
+  uint8_t letters[NEO_PIXELS];  // the word being placed, 0..25; longer ones can't fit anyway
+  int pos = 0;                  // first free reading position
+  int used = 0;                 // chars of text on the face
+  bool placed = false;          // a word is on the face, the next one needs a space
+  out.clear();
+  for (;;) {
+    // one word: letters up to the next space or the end
+    int i = used;
+    int n = 0;
+    int len;
+    int l;
+    bool fits = true;
+    while ((l = _letter(&text[i], len)) != MESSAGE_END && l != MESSAGE_SPACE) {
+      if (l != MESSAGE_SKIP) {
+        if (n < NEO_PIXELS) {
+          letters[n++] = l;
+        } else {
+          fits = false;
+        };
+      };
+      i += len;
+    };
+    if (n > 0) {
+      int end = fits ? _place(letters, n, placed ? pos + 1 : pos, out) : -1;
+      if (end < 0 && placed) {
+        return used;  // the rest goes on the next page
+      };
+      // (a word that doesn't fit on an empty face is dropped, so the caller moves on)
+      if (end >= 0) {
+        pos = end;
+        placed = true;
+      };
+    };
+    used = i + len;
+    if (l == MESSAGE_END) {
+      return used;
+    };
+  };
+};
+
+// one word from reading position 'from' on: in one piece on a row if it can be,
+// else letter by letter; returns the position after its last letter, -1 if it won't fit
+int Message::_place(const uint8_t *letters, int n, int from, FrameMask &out) {
+  for (int s = _find(letters[0], from); s >= 0; s = _find(letters[0], s + 1)) {
+    if (s % Face::COL_COUNT + n > Face::COL_COUNT) {
+      continue;
+    };
+    int k = 1;
+    while (k < n && letterIndex[letters[k]].test(s + k)) {
+      k++;
+    };
+    if (k == n) {
+      for (k = 0; k < n; k++) {
+        out.set(stripIndex(s + k));
+      };
+      return s + n;
+    };
+  };
+  // scattered: every letter the first one after the previous, check it fits before lighting
+  int p = from - 1;
+  for (int k = 0; k < n && p < NEO_PIXELS; k++) {
+    p = _find(letters[k], p + 1);
+    if (p < 0) {
+      return -1;
+    };
+  };
+  p = from - 1;
+  for (int k = 0; k < n; k++) {
+    p = _find(letters[k], p + 1);
+    out.set(stripIndex(p));
+  };
+  return p + 1;
+};
+
+// next character as a letter 0..25 (A..Z, umlauts folded), or MESSAGE_END/SPACE/SKIP;
+// len is the number of bytes it took
+int Message::_letter(const char *text, int &len) {
+  uint8_t c = text[0];
+  len = 1;
+  if (c == '\0') {
+    len = 0;
+    return MESSAGE_END;
+  };
+  if (c == ' ') {
+    return MESSAGE_SPACE;
+  };
+  if (c >= 'A' && c <= 'Z') {
+    return c - 'A';
+  };
+  if (c >= 'a' && c <= 'z') {
+    return c - 'a';
+  };
+  // UTF-8 Ä ä Ö ö Ü ü
+  if (c == 0xC3 && text[1] != '\0') {
+    len = 2;
+    switch ((uint8_t)text[1]) {
+      case 0x84:
+      case 0xA4:
+        return 'A' - 'A';
+      case 0x96:
+      case 0xB6:
+        return 'O' - 'A';
+      case 0x9C:
+      case 0xBC:
+        return 'U' - 'A';
+      default:
+        break;
+    };
+  };
+  return MESSAGE_SKIP;
+};
+
+// first reading position >= from with this letter, -1 if there's none left
+int Message::_find(int letter, int from) {
+  if (from >= NEO_PIXELS) {
+    return -1;
+  };
+  const FrameMask &m = letterIndex[letter];
+  int w = from >> 5;
+  uint32_t bits = m.w[w] & (0xFFFFFFFFUL << (from & 31));
+  while (bits == 0) {
+    if (++w >= FRAME_MASK_WORDS) {
+      return -1;
+    };
+    bits = m.w[w];
+  };
+  return (w << 5) + __builtin_ctz(bits);
+};
+
+#ifdef DEBUG
+#define MESSAGE_BENCH_RUNS 1000
+
+static void _bench(Print &out, const char *name, const char *text) {
+  FrameMask mask;
+  int used = 0;
+  unsigned long start = micros();
+  for (int r = 0; r < MESSAGE_BENCH_RUNS; r++) {
+    used = Message::compose(text, mask);
+  };
+  unsigned long us = micros() - start;
+  out.print("Message: ");
+  out.print(name);
+  out.print(" ");
+  out.print(used);
+  out.print(" chars, ");
+  out.print(mask.count());
+  out.print(" letters, ");
+  out.print((float)us / MESSAGE_BENCH_RUNS);
+  out.println(" us");
+}
+
+// worst cases for compose(): the longest text that fits, the most paging, quick misses
+void Message::benchmark(Print &out) {
+  char face[NEO_PIXELS + 1];
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    // every letter on the face, in order, as one word: all of them match
+    char c = gridLetter(p);
+    face[p] = (c >= 'A' && c <= 'Z') || foldLetter(c) != c ? c : '-';
+  };
+  face[NEO_PIXELS] = '\0';
+  _bench(out, "face", face);
+  _bench(out, "scatter", "IEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEIEI");
+  _bench(out, "words", "ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF ELF");
+  _bench(out, "miss", "QQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQQ");
+  _bench(out, "umlauts", "DR\xc3\x9c F\xc3\x9c F Z\xc3\x84H \xc3\x84S \xc3\x96");
+};
+#endif
+
+#endif  // MESSAGE
@@ -0,0 +1,42 @@
+#ifndef MESSAGE_H
+#define MESSAGE_H
+
+/* Free text on the face (#define MESSAGE in WordClock.h).
+ *
+ * The face knows its words as hard-coded pixel lists, but 144 letters can spell a
+ * lot more: "HOI", names, "DRÜ ZWEI EIS". compose() finds letters for a text the
+ * way a word clock reads, top to bottom and left to right, and returns the pixels
+ * to light. A word goes on in one piece, along a row, where it can; otherwise
+ * letter by letter.
+ *
+ * The letter -> position index is built at compile time from wordClockString (see
+ * Message.cpp): one FrameMask per letter A..Z, bits in reading order. Umlauts fold
+ * to their vowel, so Ä/ä/A all match A and Ä on the face. Matching is greedy: a word
+ * in one piece takes the first row where it's spelled out, a scattered word takes
+ * for every letter the first position after the previous one (found with one ctz
+ * over at most FRAME_MASK_WORDS words), which is also the placement most likely to
+ * leave room for the rest. A space needs at least one unlit letter before the next
+ * word. Characters the face doesn't have (digits, punctuation) are skipped.
+ *
+ * A text that doesn't fit in one go is cut at a word boundary; compose() returns
+ * how much of it it used, so the caller can page through the rest.
+ */
+
+#include <Arduino.h>
+#include "FrameMask.h"
+
+#define MESSAGE_MAX_LEN 64      // chars of text, UTF-8 umlauts are 2
+
+class Message {
+public:
+  static int compose(const char *text, FrameMask &out);
+#ifdef DEBUG
+  static void benchmark(Print &out);
+#endif
+private:
+  static int _letter(const char *text, int &len);
+  static int _place(const uint8_t *letters, int n, int from, FrameMask &out);
+  static int _find(int letter, int from);
+};
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * This is NeoSegments.cpp
+ */
+
+#include "WordClock.h"          // NEO_SEGMENTS, NEO_SEGMENT_MAP, NEO_PIXELS
+
+static constexpr NeoSegment neoSegments[] = { NEO_SEGMENT_MAP };
+static_assert(sizeof(neoSegments) / sizeof(neoSegments[0]) == NEO_SEGMENTS, "NEO_SEGMENT_MAP needs NEO_SEGMENTS entries");
+static_assert(NEO_RMT_BLOCKS >= 1, "one RMT channel per segment, and not more than there are TX channels");
+
+// segments i.. start where the previous one ended and end at the last pixel
+static constexpr bool segmentsCover(int i, int first) {
+  return i == NEO_SEGMENTS ? first == NEO_PIXELS
+       : neoSegments[i].first == first && neoSegments[i].count > 0 && segmentsCover(i + 1, first + neoSegments[i].count);
+}
+static_assert(segmentsCover(0, 0), "NEO_SEGMENT_MAP must cover the strip, in order, without gaps");
+
+// WS2812 bit timing in RMT ticks, 80 MHz APB / 2 = 25 ns
+#define NEO_RMT_CLK_DIV 2
+#define NEO_T0H 16              // 0.40 us
+#define NEO_T0L 34              // 0.85 us
+#define NEO_T1H 32              // 0.80 us
+#define NEO_T1L 18              // 0.45 us
+
+NeoSegments::NeoSegments(uint16_t n, int16_t pin, neoPixelType type) : Adafruit_NeoPixel(n, pin, type) {
+  _installed = false;
+  _lastShow = 0;
+  _showMicros = 0;
+  memset(_wire, 0, sizeof(_wire));
+};
+
+// one channel per segment, installed for good; channel i owns NEO_RMT_BLOCKS blocks of
+// RMT memory, so the channels used are 0, NEO_RMT_BLOCKS, 2 * NEO_RMT_BLOCKS, ...
+void NeoSegments::begin() {
+  if (_installed) {
+    return;
+  };
+  for (int s = 0; s < NEO_SEGMENTS; s++) {
+    rmt_channel_t channel = (rmt_channel_t)(s * NEO_RMT_BLOCKS);
+    rmt_config_t config = RMT_DEFAULT_CONFIG_TX((gpio_num_t)neoSegments[s].pin, channel);
+    config.clk_div = NEO_RMT_CLK_DIV;
+    config.mem_block_num = NEO_RMT_BLOCKS;
+    rmt_config(&config);
+    rmt_driver_install(channel, 0, 0);
+    rmt_translator_init(channel, _translate);
+  };
+  _installed = true;
+#ifdef ECHO
+  int longest = 0;
+  for (int s = 0; s < NEO_SEGMENTS; s++) {
+    if (neoSegments[s].count > longest) {
+      longest = neoSegments[s].count;
+    };
+  };
+  Serial.print("NeoSegments: ");
+  Serial.print(NEO_SEGMENTS);
+  Serial.print(" segments, longest ");
+  Serial.print(longest);
+  Serial.print(" pixels, ~");
+  Serial.print(longest * 30);  // 24 bits at 1.25 us
+  Serial.println(" us per frame");
+#endif
+};
+
+// all segments start together, done when the longest one is
+void NeoSegments::show() {
+  if (!_installed) {
+    begin();
+  };
+  const uint8_t *pixels = getPixels();
+  // Adafruit keeps the buffer in wire order (GRB) already, we only reorder segments
+  for (int s = 0; s < NEO_SEGMENTS; s++) {
+    const NeoSegment &seg = neoSegments[s];
+    if (seg.reversed) {
+      for (int i = 0; i < seg.count; i++) {
+        memcpy(&_wire[3 * (seg.first + i)], &pixels[3 * (seg.first + seg.count - 1 - i)], 3);
+      };
+    } else {
+      memcpy(&_wire[3 * seg.first], &pixels[3 * seg.first], 3 * seg.count);
+    };
+  };
+  // the strips need to see the line low for a while to latch the last frame
+  while (micros() - _lastShow < NEO_LATCH_MICROS) {
+  };
+  unsigned long start = micros();
+  for (int s = 0; s < NEO_SEGMENTS; s++) {
+    rmt_write_sample((rmt_channel_t)(s * NEO_RMT_BLOCKS), &_wire[3 * neoSegments[s].first], 3 * neoSegments[s].count, false);
+  };
+  for (int s = 0; s < NEO_SEGMENTS; s++) {
+    rmt_wait_tx_done((rmt_channel_t)(s * NEO_RMT_BLOCKS), portMAX_DELAY);
+  };
+  _lastShow = micros();
+  _showMicros = _lastShow - start;
+};
+
+uint32_t NeoSegments::showMicros() {
+  return _showMicros;
+};
+
+// bytes -> RMT items, MSB first; runs in the RMT interrupt as the channel memory drains
+void IRAM_ATTR NeoSegments::_translate(const void *src, rmt_item32_t *dest, size_t src_size,
+                                       size_t wanted_num, size_t *translated_size, size_t *item_num) {
+  if (src == NULL || dest == NULL) {
+    *translated_size = 0;
+    *item_num = 0;
+    return;
+  };
+  const rmt_item32_t bit0 = { { { NEO_T0H, 1, NEO_T0L, 0 } } };
+  const rmt_item32_t bit1 = { { { NEO_T1H, 1, NEO_T1L, 0 } } };
+  const uint8_t *in = (const uint8_t *)src;
+  size_t size = 0;
+  size_t num = 0;
+  while (size < src_size && num + 8 <= wanted_num) {
+    for (int b = 7; b >= 0; b--) {
+      dest[num++].val = ((in[size] >> b) & 1) ? bit1.val : bit0.val;
+    };
+    size++;
+  };
+  *translated_size = size;
+  *item_num = num;
+};
@@ -0,0 +1,63 @@
+#ifndef NEO_SEGMENTS_H
+#define NEO_SEGMENTS_H
+
+/* LED output over the RMT, on one data pin or in parallel over several (NEO_SEGMENTS
+ * in WordClock.h).
+ *
+ * One 800 kHz data line sends 24 bits in 30 us per pixel: 144 pixels take ~4.3 ms,
+ * a 16x16 face 7.7 ms, 20x20 12 ms, and DITHER wants to refresh at 200 Hz. Cutting
+ * the strip into segments, each with its own data pin and its own RMT channel, and
+ * starting them all at once makes a frame take as long as the longest segment.
+ *
+ * NEO_SEGMENT_MAP says which part of the logical strip goes to which pin:
+ *
+ *   { pin, first pixel, pixel count, reversed }
+ *
+ * Segments follow each other along the strip (checked at compile time). A reversed
+ * segment is wired from its far end, so a face can be fed from the middle.
+ *
+ * NeoSegments is an Adafruit_NeoPixel as far as the rest of the code is concerned
+ * (pixel buffer, setPixelColor(), getPixelColor(), ...); only show() is different,
+ * and it is the NeoStrip everybody uses, one segment or several. Adafruit's ESP32
+ * show() installs and removes the RMT driver on every frame: a malloc and a free
+ * each time, 200 times a second with DITHER, and the set up time lands in the middle
+ * of the refresh. Here the channels are set up once in begin() and stay. show()
+ * returns when every segment has been sent; showMicros() is how long the last frame
+ * took on the wire.
+ */
+
+#include <Arduino.h>
+#include <Adafruit_NeoPixel.h>
+
+struct NeoSegment {
+  int pin;
+  int first;
+  int count;
+  bool reversed;
+};
+
+#include <driver/rmt.h>
+#include <soc/soc_caps.h>
+
+// RMT memory blocks per channel: 8 TX capable blocks on the ESP32, 4 on the -S2, 2 on the -C3
+#define NEO_RMT_BLOCKS (SOC_RMT_TX_CANDIDATES_PER_GROUP / NEO_SEGMENTS)
+#define NEO_LATCH_MICROS 300               // low time between frames, newer WS2812B want 280 us
+
+class NeoSegments : public Adafruit_NeoPixel {
+public:
+  NeoSegments(uint16_t n, int16_t pin, neoPixelType type);
+  void begin();
+  void show();
+  uint32_t showMicros();
+private:
+  bool _installed;
+  unsigned long _lastShow;
+  uint32_t _showMicros;
+  uint8_t _wire[NEO_PIXELS * 3];  // frame in segment order, what the channels send
+  static void IRAM_ATTR _translate(const void *src, rmt_item32_t *dest, size_t src_size,
+                                   size_t wanted_num, size_t *translated_size, size_t *item_num);
+};
+
+typedef NeoSegments NeoStrip;
+
+#endif
@@ -0,0 +1,322 @@
+/*
+ * This is OTAUpdate.cpp
+ */
+
+#include "WordClock.h"          // FIRMWARE_VERSION, ECHO/DEBUG/OTA_UPDATE switches
+#ifdef OTA_UPDATE
+#ifndef OTA_PUBLIC_KEY
+#error "OTA_UPDATE needs OTA_PUBLIC_KEY in utils.h, see OTAUpdate.h"
+#endif
+#include <HTTPClient.h>         // https://github.com/espressif/arduino-esp32/tree/master/libraries/HTTPClient
+#include <mbedtls/sha256.h>     // part of ESP-IDF
+#include <mbedtls/pk.h>
+#include <esp_timer.h>
+#include <sdkconfig.h>
+
+#ifndef CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE
+#warning "this core is built without app rollback: a bad OTA image can't fall back, see OTAUpdate.h"
+#endif
+
+// the download buffer lives in .bss, not on the task stack and not on the heap
+uint8_t OTAUpdate::_chunk[OTA_CHUNK_SIZE];
+
+static esp_timer_handle_t validateTimer = NULL;
+
+// tell the Arduino core we validate (or roll back) the app ourselves, see markValid()
+extern "C" bool verifyRollbackLater() {
+  return true;
+}
+
+// a freshly flashed image did not manage to render a minute in time: go back
+static void _validateTimeout(void *arg) {
+#ifdef ECHO
+  Serial.println("OTA: new image not validated in time, rolling back");
+#endif
+  esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+static int _hexNibble(char c) {
+  if (c >= '0' && c <= '9') return c - '0';
+  if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+  if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+  return -1;
+}
+
+// dotted versions, number by number ("2024.9.1" < "2024.10.23"): < 0, 0 or > 0;
+// anything but digits and dots compares as older than everything
+static int _compareVersions(const char *a, const char *b) {
+  if (strspn(a, "0123456789.") != strlen(a) || *a == '\0') {
+    return -1;
+  };
+  while (*a != '\0' || *b != '\0') {
+    char *endA;
+    char *endB;
+    unsigned long x = strtoul(a, &endA, 10);
+    unsigned long y = strtoul(b, &endB, 10);
+    if (x != y) {
+      return x < y ? -1 : 1;
+    };
+    a = *endA == '.' ? endA + 1 : endA;
+    b = *endB == '.' ? endB + 1 : endB;
+  };
+  return 0;
+}
+
+OTAUpdate::OTAUpdate() {
+  _busy = false;
+  _progress = 0;
+  _pendingVerify = false;
+  _noRollback = false;
+  _version[0] = '\0';
+};
+
+// called early in WordClock::begin(), before we wait for WiFi
+void OTAUpdate::begin() {
+  const esp_partition_t *running = esp_ota_get_running_partition();
+  esp_ota_img_states_t state;
+  if (esp_ota_get_state_partition(running, &state) != ESP_OK) {
+    return;  // factory app or flashed over USB, nothing to verify
+  };
+  if (state == ESP_OTA_IMG_NEW) {
+    // we got here straight after an update, but the bootloader didn't turn it
+    // into PENDING_VERIFY: it can't roll back, so don't risk another one
+    _noRollback = true;
+    esp_ota_mark_app_valid_cancel_rollback();
+#ifdef ECHO
+    Serial.println("OTA: bootloader without rollback, updates disabled (see OTAUpdate.h)");
+#endif
+    return;
+  };
+  if (state == ESP_OTA_IMG_PENDING_VERIFY) {
+    _pendingVerify = true;
+#ifdef ECHO
+    Serial.print("OTA: running new image ");
+    Serial.print(FIRMWARE_VERSION);
+    Serial.println(", pending verification");
+#endif
+    // if we hang waiting for WiFi (watchdog isn't armed yet) this gets us back
+    esp_timer_create_args_t args = {};
+    args.callback = &_validateTimeout;
+    args.name = "ota_validate";
+    esp_timer_create(&args, &validateTimer);
+    esp_timer_start_once(validateTimer, (uint64_t)OTA_VALIDATE_TIMEOUT * 1000000ULL);
+  };
+};
+
+// first minute rendered, so this image works - keep it
+void OTAUpdate::markValid() {
+  if (!_pendingVerify) {
+    return;
+  };
+  esp_timer_stop(validateTimer);
+  esp_ota_mark_app_valid_cancel_rollback();
+  _pendingVerify = false;
+#ifdef ECHO
+  Serial.println("OTA: new image marked valid");
+#endif
+};
+
+bool OTAUpdate::busy() {
+  return _busy;
+};
+
+int OTAUpdate::progress() {
+  return _progress;
+};
+
+// start the background check/download, returns immediately
+void OTAUpdate::check() {
+  if (_busy || _pendingVerify || _noRollback) {
+    return;
+  };
+  _busy = true;
+  _progress = 0;
+  if (xTaskCreatePinnedToCore(_task, "ota", OTA_TASK_STACK, this, 1, NULL, OTA_TASK_CORE) != pdPASS) {
+    _busy = false;
+  };
+};
+
+void OTAUpdate::_task(void *arg) {
+  OTAUpdate *self = (OTAUpdate *)arg;
+  if (self->_fetchManifest()) {
+    if (self->_download()) {
+#ifdef ECHO
+      Serial.println("OTA: update written, restarting");
+#endif
+      delay(100);
+      ESP.restart();
+    };
+  };
+  self->_busy = false;
+  vTaskDelete(NULL);
+};
+
+// read "<version> <sha256hex> <signature>" from the manifest, true if it's a signed update for us
+bool OTAUpdate::_fetchManifest() {
+  HTTPClient http;
+  http.setTimeout(OTA_HTTP_TIMEOUT);
+  if (!http.begin(OTA_MANIFEST_URL)) {
+    return false;
+  };
+  int code = http.GET();
+  if (code != HTTP_CODE_OK) {
+#ifdef DEBUG
+    Serial.print("OTA: manifest HTTP ");
+    Serial.println(code);
+#endif
+    http.end();
+    return false;
+  };
+
+  // the manifest is tiny, read it into the chunk buffer
+  WiFiClient *stream = http.getStreamPtr();
+  stream->setTimeout(OTA_HTTP_TIMEOUT);
+  size_t n = stream->readBytesUntil('\n', (char *)_chunk, OTA_CHUNK_SIZE - 1);
+  http.end();
+  _chunk[n] = '\0';
+
+  char *line = (char *)_chunk;
+  char *space = strchr(line, ' ');
+  if (space == NULL || space - line >= (int)sizeof(_version) || strlen(space + 1) < 64 + 1 || space[65] != ' ') {
+    return false;
+  };
+  // nothing in here counts until the signature over "<version> <sha256hex>" does
+  if (!_verify(line, space + 65 - line, space + 66)) {
+#ifdef ECHO
+    Serial.println("OTA: manifest signature doesn't check out, ignored");
+#endif
+    return false;
+  };
+  *space = '\0';
+  if (_compareVersions(line, FIRMWARE_VERSION) <= 0) {
+    return false;  // running it already, or older: a stale or replayed manifest
+  };
+  strcpy(_version, line);
+  const char *hex = space + 1;
+  for (int i = 0; i < 32; i++) {
+    int hi = _hexNibble(hex[2 * i]);
+    int lo = _hexNibble(hex[2 * i + 1]);
+    if (hi < 0 || lo < 0) {
+      return false;
+    };
+    _sha256[i] = (hi << 4) | lo;
+  };
+#ifdef ECHO
+  Serial.print("OTA: ");
+  Serial.print(FIRMWARE_VERSION);
+  Serial.print(" -> ");
+  Serial.println(_version);
+#endif
+  return true;
+};
+
+// ECDSA signature (DER, hex) over the SHA-256 of text, against OTA_PUBLIC_KEY
+bool OTAUpdate::_verify(const char *text, size_t len, const char *sig) {
+  uint8_t der[80];              // a P-256 signature is at most 72 bytes
+  size_t n = 0;
+  while (n < sizeof(der) && _hexNibble(sig[2 * n]) >= 0 && _hexNibble(sig[2 * n + 1]) >= 0) {
+    der[n] = (_hexNibble(sig[2 * n]) << 4) | _hexNibble(sig[2 * n + 1]);
+    n++;
+  };
+  if (n == 0 || n == sizeof(der)) {
+    return false;
+  };
+  uint8_t digest[32];
+  mbedtls_sha256_ret((const unsigned char *)text, len, digest, 0);
+  static const char key[] = OTA_PUBLIC_KEY;
+  mbedtls_pk_context pk;
+  mbedtls_pk_init(&pk);
+  bool ok = mbedtls_pk_parse_public_key(&pk, (const unsigned char *)key, sizeof(key)) == 0 &&
+            mbedtls_pk_verify(&pk, MBEDTLS_MD_SHA256, digest, sizeof(digest), der, n) == 0;
+  mbedtls_pk_free(&pk);
+  return ok;
+};
+
+// stream the image into the inactive partition, chunk by chunk, hashing as we go
+bool OTAUpdate::_download() {
+  const esp_partition_t *target = esp_ota_get_next_update_partition(NULL);
+  if (target == NULL) {
+    return false;
+  };
+
+  HTTPClient http;
+  http.setTimeout(OTA_HTTP_TIMEOUT);
+  if (!http.begin(OTA_FIRMWARE_URL)) {
+    return false;
+  };
+  if (http.GET() != HTTP_CODE_OK) {
+    http.end();
+    return false;
+  };
+  int total = http.getSize();  // -1 if the server doesn't say
+  if (total > 0 && (uint32_t)total > target->size) {
+    http.end();
+    return false;
+  };
+
+  esp_ota_handle_t handle;
+  if (esp_ota_begin(target, OTA_SIZE_UNKNOWN, &handle) != ESP_OK) {
+    http.end();
+    return false;
+  };
+
+  mbedtls_sha256_context sha;
+  mbedtls_sha256_init(&sha);
+  mbedtls_sha256_starts_ret(&sha, 0);
+
+  WiFiClient *stream = http.getStreamPtr();
+  int done = 0;
+  bool ok = true;
+  unsigned long lastData = millis();
+  while (total < 0 || done < total) {
+    int avail = stream->available();
+    if (avail <= 0) {
+      if (!http.connected() && total < 0) {
+        break;  // no Content-Length, server closed: we're done
+      };
+      if (millis() - lastData > OTA_HTTP_TIMEOUT) {
+        ok = false;
+        break;
+      };
+      delay(1);
+      continue;
+    };
+    int n = stream->read(_chunk, avail < OTA_CHUNK_SIZE ? avail : OTA_CHUNK_SIZE);
+    if (n <= 0) {
+      continue;
+    };
+    lastData = millis();
+    mbedtls_sha256_update_ret(&sha, _chunk, n);
+    if (esp_ota_write(handle, _chunk, n) != ESP_OK) {
+      ok = false;
+      break;
+    };
+    done += n;
+    if (total > 0) {
+      _progress = (int)(100LL * done / total);
+    };
+  };
+  http.end();
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish_ret(&sha, digest);
+  mbedtls_sha256_free(&sha);
+  if (ok && memcmp(digest, _sha256, sizeof(digest)) != 0) {
+#ifdef ECHO
+    Serial.println("OTA: SHA-256 mismatch, update discarded");
+#endif
+    ok = false;
+  };
+  if (!ok) {
+    esp_ota_abort(handle);
+    return false;
+  };
+  // esp_ota_end() checks the image header and its own checksum, too
+  if (esp_ota_end(handle) != ESP_OK || esp_ota_set_boot_partition(target) != ESP_OK) {
+    return false;
+  };
+  _progress = 100;
+  return true;
+};
+
+#endif  // OTA_UPDATE
@@ -0,0 +1,82 @@
+#ifndef OTA_UPDATE_H
+#define OTA_UPDATE_H
+
+/* Over-the-air firmware update, so the clock can stay on the wall.
+ *
+ * Once an hour WordClock::loop() calls OTAUpdate::check(). That spins up a small
+ * task on core 0 which fetches a one-line manifest from OTA_MANIFEST_URL:
+ *
+ *   <version> <sha256 of the .bin, 64 hex chars> <signature, hex>
+ *
+ * The signature is ECDSA P-256 (DER) over the SHA-256 of "<version> <sha256>", made
+ * with a key only you have; the clock checks it against OTA_PUBLIC_KEY (utils.h)
+ * before it believes a word of the manifest. Plain HTTP is fine then: whoever can
+ * answer for the server can withhold updates, but can't make the clock flash an
+ * image you didn't sign. Off by default (WordClock.h) until you've made a key.
+ *
+ * If the version is newer than FIRMWARE_VERSION (compared number by number between
+ * the dots; the same or older, e.g. a stale or replayed manifest, is ignored, so
+ * no downgrades), the image at OTA_FIRMWARE_URL is streamed straight into the
+ * inactive OTA partition in OTA_CHUNK_SIZE pieces (no full-image buffer in RAM),
+ * hashed on the fly, and only marked bootable if the SHA-256 matches the signed
+ * one. The render loop keeps running on core 1 in the meantime.
+ *
+ * After the reboot the new image is PENDING_VERIFY. It becomes valid when the
+ * first minute has been rendered (markValid()); if it crashes, trips the watchdog
+ * or doesn't get there within OTA_VALIDATE_TIMEOUT seconds, the bootloader falls
+ * back to the previous image.
+ *
+ * That needs a bootloader built with CONFIG_BOOTLOADER_APP_ROLLBACK_ENABLE; the
+ * one the Arduino core flashes may not be. begin() checks: if a freshly updated
+ * image comes up NEW instead of PENDING_VERIFY, the bootloader left it alone, so
+ * it is kept and no further updates are tried (there'd be no way back from a bad
+ * one). Flash a rollback-enabled bootloader over USB (ESP-IDF, idf.py menuconfig
+ * -> Bootloader config -> Enable app rollback support) to get them back. A core
+ * built without the option at all gets a compile-time warning.
+ *
+ * A signing key, once (keep ota_key.pem off the clock and out of git):
+ *   openssl ecparam -name prime256v1 -genkey -noout -out ota_key.pem
+ *   openssl ec -in ota_key.pem -pubout
+ * and paste what the second command prints into OTA_PUBLIC_KEY (utils.h).
+ *
+ * Testing from a laptop on the same LAN:
+ *   Sketch -> Export Compiled Binary, then in the build folder
+ *   cp SwissWordClock*.ino.bin wordclock.bin
+ *   python3 tools/ota_sign.py ota_key.pem 2024.11.01 wordclock.bin > wordclock.txt
+ *   python3 -m http.server 8000
+ * and point OTA_MANIFEST_URL / OTA_FIRMWARE_URL (utils.h) at that machine.
+ */
+
+#include <Arduino.h>
+#include <esp_ota_ops.h>        // https://docs.espressif.com/projects/esp-idf/en/v4.4/esp32/api-reference/system/ota.html
+#include "utils.h"              // local OTA urls
+
+#define OTA_CHUNK_SIZE 1024         // bytes per read/write/hash step
+#define OTA_HTTP_TIMEOUT 10000      // ms without data before we give up on a download
+#define OTA_VALIDATE_TIMEOUT 300    // s, a new image has this long to render its first minute
+#define OTA_TASK_STACK 6144         // bytes, HTTPClient + mbedtls context need a bit
+#define OTA_TASK_CORE 0             // the Arduino loop() and the face run on core 1
+
+class OTAUpdate {
+public:
+  OTAUpdate();
+  void begin();
+  void check();
+  void markValid();
+  bool busy();
+  int progress();
+private:
+  volatile bool _busy;
+  volatile int _progress;     // 0..100 % of the current download
+  bool _pendingVerify;
+  bool _noRollback;           // the bootloader can't roll back, no more updates
+  char _version[32];
+  uint8_t _sha256[32];
+  static uint8_t _chunk[OTA_CHUNK_SIZE];
+  static void _task(void *arg);
+  bool _fetchManifest();
+  bool _verify(const char *text, size_t len, const char *sig);
+  bool _download();
+};
+
+#endif
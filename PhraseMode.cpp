@@ -0,0 +1,227 @@
+/*
+ * This is PhraseMode.cpp
+ */
+
+#include <string.h>
+#include "FaceLayout.h"         // the word pixel lists
+#include "PhraseMode.h"
+
+const int *const phraseWords[PW_COUNT] = {
+  wordNone,
+  wordSoon, wordQuarter, wordHalf, wordTo, wordPast, wordBeen,
+  wordMinuteOne, wordMinuteTwo, wordMinuteThree, wordMinuteFour, wordMinuteFive, wordMinuteSix,
+  wordMinuteSeven, wordMinuteEight, wordMinuteNine, wordMinuteTen,
+  wordMinuteEleven, wordMinuteTwelve, wordMinuteTwenty,
+  wordMinuteTwentyOne, wordMinuteTwentyTwo, wordMinuteTwentyThree, wordMinuteTwentyFour, wordMinuteTwentyFive,
+  wordMinuteTwentySix, wordMinuteTwentySeven, wordMinuteTwentyEight, wordMinuteTwentyNine
+};
+
+// as it always was: fuzzy around the quarters, "BALD", "GSI", next hour from :23
+static const PhraseMinute phraseSemiExact[60] = {
+  { { PW_NONE }, 0 },                                     //  0
+  { { PW_ONE, PW_PAST }, 0 },                             //  1
+  { { PW_TWO, PW_PAST }, 0 },                             //  2
+  { { PW_THREE, PW_PAST }, 0 },                           //  3
+  { { PW_FOUR, PW_PAST }, 0 },                            //  4
+  { { PW_FIVE, PW_PAST }, 0 },                            //  5
+  { { PW_SIX, PW_PAST }, 0 },                             //  6
+  { { PW_SEVEN, PW_PAST }, 0 },                           //  7
+  { { PW_EIGHT, PW_PAST }, 0 },                           //  8
+  { { PW_NINE, PW_PAST }, 0 },                            //  9
+  { { PW_TEN, PW_PAST }, 0 },                             // 10
+  { { PW_ELEVEN, PW_PAST }, 0 },                          // 11
+  { { PW_TWELVE, PW_PAST }, 0 },                          // 12
+  { { PW_SOON, PW_QUARTER, PW_PAST }, 0 },                // 13
+  { { PW_SOON, PW_QUARTER, PW_PAST }, 0 },                // 14
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 15
+  { { PW_SIX, PW_TEN, PW_PAST, PW_BEEN }, 0 },            // 16
+  { { PW_SEVEN, PW_TEN, PW_PAST, PW_BEEN }, 0 },          // 17
+  { { PW_SOON, PW_TWENTY, PW_PAST }, 0 },                 // 18
+  { { PW_SOON, PW_TWENTY, PW_PAST }, 0 },                 // 19
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 20
+  { { PW_TWENTY_ONE, PW_PAST, PW_BEEN }, 0 },             // 21
+  { { PW_TWENTY_TWO, PW_PAST, PW_BEEN }, 0 },             // 22
+  { { PW_SOON, PW_FIVE, PW_TO, PW_HALF }, 1 },            // 23
+  { { PW_SOON, PW_FIVE, PW_TO, PW_HALF }, 1 },            // 24
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 25
+  { { PW_FOUR, PW_TO, PW_HALF }, 1 },                     // 26
+  { { PW_THREE, PW_TO, PW_HALF }, 1 },                    // 27
+  { { PW_TWO, PW_TO, PW_HALF }, 1 },                      // 28
+  { { PW_ONE, PW_TO, PW_HALF }, 1 },                      // 29
+  { { PW_HALF }, 1 },                                     // 30
+  { { PW_ONE, PW_PAST, PW_HALF }, 1 },                    // 31
+  { { PW_TWO, PW_PAST, PW_HALF }, 1 },                    // 32
+  { { PW_THREE, PW_PAST, PW_HALF }, 1 },                  // 33
+  { { PW_FOUR, PW_PAST, PW_HALF }, 1 },                   // 34
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 35
+  { { PW_FIVE, PW_PAST, PW_HALF, PW_BEEN }, 1 },          // 36
+  { { PW_FIVE, PW_PAST, PW_HALF, PW_BEEN }, 1 },          // 37
+  { { PW_SOON, PW_TWENTY, PW_TO }, 1 },                   // 38
+  { { PW_SOON, PW_TWENTY, PW_TO }, 1 },                   // 39
+  { { PW_TWENTY, PW_TO }, 1 },                            // 40
+  { { PW_TWENTY, PW_TO, PW_BEEN }, 1 },                   // 41
+  { { PW_TWENTY, PW_TO, PW_BEEN }, 1 },                   // 42
+  { { PW_SOON, PW_QUARTER, PW_TO }, 1 },                  // 43
+  { { PW_SOON, PW_QUARTER, PW_TO }, 1 },                  // 44
+  { { PW_QUARTER, PW_TO }, 1 },                           // 45
+  { { PW_QUARTER, PW_TO, PW_BEEN }, 1 },                  // 46
+  { { PW_QUARTER, PW_TO, PW_BEEN }, 1 },                  // 47
+  { { PW_TWELVE, PW_TO }, 1 },                            // 48
+  { { PW_ELEVEN, PW_TO }, 1 },                            // 49
+  { { PW_TEN, PW_TO }, 1 },                               // 50
+  { { PW_NINE, PW_TO }, 1 },                              // 51
+  { { PW_EIGHT, PW_TO }, 1 },                             // 52
+  { { PW_SEVEN, PW_TO }, 1 },                             // 53
+  { { PW_SIX, PW_TO }, 1 },                               // 54
+  { { PW_FIVE, PW_TO }, 1 },                              // 55
+  { { PW_FOUR, PW_TO }, 1 },                              // 56
+  { { PW_THREE, PW_TO }, 1 },                             // 57
+  { { PW_TWO, PW_TO }, 1 },                               // 58
+  { { PW_ONE, PW_TO }, 1 },                               // 59
+};
+
+// rounded down to five minutes, next hour from :25
+static const PhraseMinute phraseFiveMinute[60] = {
+  { { PW_NONE }, 0 },                                     //  0
+  { { PW_NONE }, 0 },                                     //  1
+  { { PW_NONE }, 0 },                                     //  2
+  { { PW_NONE }, 0 },                                     //  3
+  { { PW_NONE }, 0 },                                     //  4
+  { { PW_FIVE, PW_PAST }, 0 },                            //  5
+  { { PW_FIVE, PW_PAST }, 0 },                            //  6
+  { { PW_FIVE, PW_PAST }, 0 },                            //  7
+  { { PW_FIVE, PW_PAST }, 0 },                            //  8
+  { { PW_FIVE, PW_PAST }, 0 },                            //  9
+  { { PW_TEN, PW_PAST }, 0 },                             // 10
+  { { PW_TEN, PW_PAST }, 0 },                             // 11
+  { { PW_TEN, PW_PAST }, 0 },                             // 12
+  { { PW_TEN, PW_PAST }, 0 },                             // 13
+  { { PW_TEN, PW_PAST }, 0 },                             // 14
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 15
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 16
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 17
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 18
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 19
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 20
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 21
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 22
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 23
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 24
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 25
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 26
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 27
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 28
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 29
+  { { PW_HALF }, 1 },                                     // 30
+  { { PW_HALF }, 1 },                                     // 31
+  { { PW_HALF }, 1 },                                     // 32
+  { { PW_HALF }, 1 },                                     // 33
+  { { PW_HALF }, 1 },                                     // 34
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 35
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 36
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 37
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 38
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 39
+  { { PW_TWENTY, PW_TO }, 1 },                            // 40
+  { { PW_TWENTY, PW_TO }, 1 },                            // 41
+  { { PW_TWENTY, PW_TO }, 1 },                            // 42
+  { { PW_TWENTY, PW_TO }, 1 },                            // 43
+  { { PW_TWENTY, PW_TO }, 1 },                            // 44
+  { { PW_QUARTER, PW_TO }, 1 },                           // 45
+  { { PW_QUARTER, PW_TO }, 1 },                           // 46
+  { { PW_QUARTER, PW_TO }, 1 },                           // 47
+  { { PW_QUARTER, PW_TO }, 1 },                           // 48
+  { { PW_QUARTER, PW_TO }, 1 },                           // 49
+  { { PW_TEN, PW_TO }, 1 },                               // 50
+  { { PW_TEN, PW_TO }, 1 },                               // 51
+  { { PW_TEN, PW_TO }, 1 },                               // 52
+  { { PW_TEN, PW_TO }, 1 },                               // 53
+  { { PW_TEN, PW_TO }, 1 },                               // 54
+  { { PW_FIVE, PW_TO }, 1 },                              // 55
+  { { PW_FIVE, PW_TO }, 1 },                              // 56
+  { { PW_FIVE, PW_TO }, 1 },                              // 57
+  { { PW_FIVE, PW_TO }, 1 },                              // 58
+  { { PW_FIVE, PW_TO }, 1 },                              // 59
+};
+
+// every minute its own phrase, next hour from :25; the face can't spell NÜNZÄH,
+// so :19 is "BALD ZWANZIG AB" and :41 "ZWANZIG VOR ... GSI"
+static const PhraseMinute phraseExact[60] = {
+  { { PW_NONE }, 0 },                                     //  0
+  { { PW_ONE, PW_PAST }, 0 },                             //  1
+  { { PW_TWO, PW_PAST }, 0 },                             //  2
+  { { PW_THREE, PW_PAST }, 0 },                           //  3
+  { { PW_FOUR, PW_PAST }, 0 },                            //  4
+  { { PW_FIVE, PW_PAST }, 0 },                            //  5
+  { { PW_SIX, PW_PAST }, 0 },                             //  6
+  { { PW_SEVEN, PW_PAST }, 0 },                           //  7
+  { { PW_EIGHT, PW_PAST }, 0 },                           //  8
+  { { PW_NINE, PW_PAST }, 0 },                            //  9
+  { { PW_TEN, PW_PAST }, 0 },                             // 10
+  { { PW_ELEVEN, PW_PAST }, 0 },                          // 11
+  { { PW_TWELVE, PW_PAST }, 0 },                          // 12
+  { { PW_THREE, PW_TEN, PW_PAST }, 0 },                   // 13
+  { { PW_FOUR, PW_TEN, PW_PAST }, 0 },                    // 14
+  { { PW_QUARTER, PW_PAST }, 0 },                         // 15
+  { { PW_SIX, PW_TEN, PW_PAST }, 0 },                     // 16
+  { { PW_SEVEN, PW_TEN, PW_PAST }, 0 },                   // 17
+  { { PW_EIGHT, PW_TEN, PW_PAST }, 0 },                   // 18
+  { { PW_SOON, PW_TWENTY, PW_PAST }, 0 },                 // 19
+  { { PW_TWENTY, PW_PAST }, 0 },                          // 20
+  { { PW_TWENTY_ONE, PW_PAST }, 0 },                      // 21
+  { { PW_TWENTY_TWO, PW_PAST }, 0 },                      // 22
+  { { PW_TWENTY_THREE, PW_PAST }, 0 },                    // 23
+  { { PW_TWENTY_FOUR, PW_PAST }, 0 },                     // 24
+  { { PW_FIVE, PW_TO, PW_HALF }, 1 },                     // 25
+  { { PW_FOUR, PW_TO, PW_HALF }, 1 },                     // 26
+  { { PW_THREE, PW_TO, PW_HALF }, 1 },                    // 27
+  { { PW_TWO, PW_TO, PW_HALF }, 1 },                      // 28
+  { { PW_ONE, PW_TO, PW_HALF }, 1 },                      // 29
+  { { PW_HALF }, 1 },                                     // 30
+  { { PW_ONE, PW_PAST, PW_HALF }, 1 },                    // 31
+  { { PW_TWO, PW_PAST, PW_HALF }, 1 },                    // 32
+  { { PW_THREE, PW_PAST, PW_HALF }, 1 },                  // 33
+  { { PW_FOUR, PW_PAST, PW_HALF }, 1 },                   // 34
+  { { PW_FIVE, PW_PAST, PW_HALF }, 1 },                   // 35
+  { { PW_TWENTY_FOUR, PW_TO }, 1 },                       // 36
+  { { PW_TWENTY_THREE, PW_TO }, 1 },                      // 37
+  { { PW_TWENTY_TWO, PW_TO }, 1 },                        // 38
+  { { PW_TWENTY_ONE, PW_TO }, 1 },                        // 39
+  { { PW_TWENTY, PW_TO }, 1 },                            // 40
+  { { PW_TWENTY, PW_TO, PW_BEEN }, 1 },                   // 41
+  { { PW_EIGHT, PW_TEN, PW_TO }, 1 },                     // 42
+  { { PW_SEVEN, PW_TEN, PW_TO }, 1 },                     // 43
+  { { PW_SIX, PW_TEN, PW_TO }, 1 },                       // 44
+  { { PW_QUARTER, PW_TO }, 1 },                           // 45
+  { { PW_FOUR, PW_TEN, PW_TO }, 1 },                      // 46
+  { { PW_THREE, PW_TEN, PW_TO }, 1 },                     // 47
+  { { PW_TWELVE, PW_TO }, 1 },                            // 48
+  { { PW_ELEVEN, PW_TO }, 1 },                            // 49
+  { { PW_TEN, PW_TO }, 1 },                               // 50
+  { { PW_NINE, PW_TO }, 1 },                              // 51
+  { { PW_EIGHT, PW_TO }, 1 },                             // 52
+  { { PW_SEVEN, PW_TO }, 1 },                             // 53
+  { { PW_SIX, PW_TO }, 1 },                               // 54
+  { { PW_FIVE, PW_TO }, 1 },                              // 55
+  { { PW_FOUR, PW_TO }, 1 },                              // 56
+  { { PW_THREE, PW_TO }, 1 },                             // 57
+  { { PW_TWO, PW_TO }, 1 },                               // 58
+  { { PW_ONE, PW_TO }, 1 },                               // 59
+};
+
+
+const PhraseMode phraseModes[PHRASE_MODES] = {
+  { "semi", phraseSemiExact },
+  { "five", phraseFiveMinute },
+  { "exact", phraseExact }
+};
+
+// NULL if there's no such mode
+const PhraseMode *PhraseMode::byName(const char *name) {
+  for (int i = 0; i < PHRASE_MODES; i++) {
+    if (strcmp(phraseModes[i].name, name) == 0) {
+      return &phraseModes[i];
+    };
+  };
+  return NULL;
+};
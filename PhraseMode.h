@@ -0,0 +1,51 @@
+#ifndef PHRASE_MODE_H
+#define PHRASE_MODE_H
+
+/* How the time is put into words: phrase modes.
+ *
+ * Every mode is a table in flash with one entry per minute of the hour: up to
+ * PHRASE_WORDS word IDs to light, and whether the hour shown is this one or the
+ * next ("FÜF VOR HALBI DRÜ" at 2:25). The face then just lights what the table says,
+ * the same couple of lookups for every minute and every mode; the fuzzy logic that
+ * used to live in _showMinuteSemiExact() & co. is now in the semi-exact table.
+ *
+ *   semi   as it always was: "BALD VIERTEL", "GSI", next hour from :23
+ *   five   strictly rounded down to five minutes
+ *   exact  every minute, with compounds like DRÜ+ZÄH and VIER+ZÄH
+ *
+ * The mode can be switched at run time (Serial 'p', MQTT effect "phrase <name>"),
+ * PHRASE_DEFAULT in WordClock.h is the one a boot starts with.
+ */
+
+#include <stdint.h>
+
+#define PHRASE_WORDS 4  // most words a minute needs, besides the hour
+
+// word IDs, phraseWords[] has their pixels
+enum PhraseWord : uint8_t {
+  PW_NONE = 0,
+  PW_SOON, PW_QUARTER, PW_HALF, PW_TO, PW_PAST, PW_BEEN,
+  PW_ONE, PW_TWO, PW_THREE, PW_FOUR, PW_FIVE, PW_SIX, PW_SEVEN, PW_EIGHT, PW_NINE, PW_TEN,
+  PW_ELEVEN, PW_TWELVE, PW_TWENTY,
+  PW_TWENTY_ONE, PW_TWENTY_TWO, PW_TWENTY_THREE, PW_TWENTY_FOUR, PW_TWENTY_FIVE,
+  PW_TWENTY_SIX, PW_TWENTY_SEVEN, PW_TWENTY_EIGHT, PW_TWENTY_NINE,
+  PW_COUNT
+};
+
+struct PhraseMinute {
+  uint8_t words[PHRASE_WORDS];  // PhraseWord, PW_NONE ends the list early
+  uint8_t nextHour;             // 1: show the next hour
+};
+
+enum PhraseModeId { PHRASE_SEMI_EXACT, PHRASE_FIVE_MINUTE, PHRASE_EXACT, PHRASE_MODES };
+
+struct PhraseMode {
+  const char *name;
+  const PhraseMinute *minutes;  // [60]
+  static const PhraseMode *byName(const char *name);
+};
+
+extern const int *const phraseWords[PW_COUNT];
+extern const PhraseMode phraseModes[PHRASE_MODES];
+
+#endif
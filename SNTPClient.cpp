@@ -0,0 +1,439 @@
+/*
+ * This is SNTPClient.cpp
+ */
+
+#include "WordClock.h"          // ECHO/DEBUG switches
+#include <lwip/sockets.h>
+#include <lwip/netdb.h>
+
+SNTPClient::SNTPClient(TimeBase &time, const char *const *servers, int n, uint16_t port) : _time(time) {
+  _servers = servers;
+  _n = n < SNTP_MAX_SERVERS ? n : SNTP_MAX_SERVERS;
+  _port = port;
+  _socket = -1;
+  _task = NULL;
+  _busy = false;
+  _result = false;
+  _offset_ms = 0;
+  _delay_ms = 0;
+  _server = -1;
+  memset(_addr, 0, sizeof(_addr));
+  memset(_samples, 0, sizeof(_samples));
+  _asked = 0;
+  _answered = 0;
+  _deadline = 0;
+#ifdef COOPERATIVE
+  _lookup = 0;
+  _lookupPending = false;
+  _lookupDone = false;
+  _lookupAddr = 0;
+#endif
+#ifdef SOAK
+  _soak = NULL;
+#endif
+};
+
+// call once WiFi is up: one socket for good, and the task that does the rounds
+void SNTPClient::begin() {
+#ifndef SOAK
+  _socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#ifndef COOPERATIVE
+  xTaskCreatePinnedToCore(_taskMain, "sntp", SNTP_TASK_STACK, this, 2, &_task, SNTP_TASK_CORE);
+#endif
+#endif
+};
+
+#ifdef SOAK
+// talk to the fake network instead, see Soak.h
+void SNTPClient::soak(Soak &network) {
+  _soak = &network;
+};
+#endif
+
+// start a round in the background, returns straight away
+void SNTPClient::update() {
+#ifdef SOAK
+  // no task: the round takes no virtual time, the replies carry their own t4
+  if (_busy || _soak == NULL) {
+    return;
+  };
+  _busy = true;
+  _round();
+  _busy = false;
+#elif defined(COOPERATIVE)
+  // no task either: poll() resolves, sends and collects the replies, a step at a time
+  if (_busy || _socket < 0) {
+    return;
+  };
+  _busy = true;
+  _lookup = 0;
+  _lookupPending = false;
+  poll();
+#else
+  if (_busy || _task == NULL || _socket < 0) {
+    return;
+  };
+  _busy = true;
+  xTaskNotifyGive(_task);
+#endif
+};
+
+bool SNTPClient::busy() {
+  return _busy;
+};
+
+#ifdef COOPERATIVE
+// a look for replies to the round update() started, waiting up to wait_ms for one;
+// true once it's over
+bool SNTPClient::poll(uint32_t wait_ms) {
+#ifndef SOAK
+  if (_busy && _lookup < _n) {
+    // DNS first; there's no socket to select() on, so waiting is a delay()
+    if (!_resolveStep()) {
+      if (wait_ms > 0) {
+        delay(wait_ms);
+      };
+      return false;
+    };
+    _ask();
+  };
+  if (_busy && _collect(wait_ms)) {
+    _apply();
+    _busy = false;
+  };
+#endif
+  return !_busy;
+};
+#endif
+
+// the offset applied by the last round, once; false if there's nothing new
+bool SNTPClient::takeResult(int32_t &offset_ms, int32_t &delay_ms, int &server) {
+  if (!_result) {
+    return false;
+  };
+  offset_ms = _offset_ms;
+  delay_ms = _delay_ms;
+  server = _server;
+  _result = false;
+  return true;
+};
+
+// for begin(): block until the first round has set the clock (or give up)
+bool SNTPClient::waitForTime(uint32_t timeout_ms) {
+  uint64_t start = _time.uptime_ms();
+  while (!_time.isSet() && _time.uptime_ms() - start < timeout_ms) {
+#ifdef COOPERATIVE
+    // no task to collect the replies: wait for them here, in select()
+    if (_busy) {
+      poll(50);
+      continue;
+    };
+#endif
+    delay(50);
+  };
+  return _time.isSet();
+};
+
+void SNTPClient::_taskMain(void *arg) {
+  SNTPClient *self = (SNTPClient *)arg;
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    self->_round();
+    self->_busy = false;
+  };
+};
+
+// resolve, ask everybody, collect answers until all are in or time is up
+void SNTPClient::_round() {
+  _start();
+#ifdef SOAK
+  uint32_t from;
+  int64_t t4;
+  while (_answered < _asked && _soak->reply(_packet, from, t4)) {
+    if (_parse(from, t4)) {
+      _answered++;
+    };
+  };
+#else
+  while (!_collect(SNTP_TIMEOUT)) {
+  };
+#endif
+  _apply();
+};
+
+// resolve, and send a request to every server we have an address for
+void SNTPClient::_start() {
+  _resolve();
+  _ask();
+};
+
+// a request to every server we have an address for, and the round's clock starts
+void SNTPClient::_ask() {
+  _asked = 0;
+  _answered = 0;
+  for (int i = 0; i < _n; i++) {
+    _samples[i].valid = false;
+    if (_addr[i] != 0) {
+      _send(i);
+      _asked++;
+    };
+  };
+  _deadline = _time.uptime_ms() + SNTP_TIMEOUT;
+};
+
+// wait up to wait_ms for replies and take all that are in; true when all are in or the
+// round's time is up. Past the deadline it still takes what's waiting in the socket:
+// with COOPERATIVE the first look can come late, the replies are there all the same
+bool SNTPClient::_collect(uint32_t wait_ms) {
+  if (_answered >= _asked) {
+    return true;
+  };
+  uint64_t now_ms = _time.uptime_ms();
+  uint32_t left = now_ms < _deadline ? _deadline - now_ms : 0;
+  uint32_t wait = left < wait_ms ? left : wait_ms;
+  fd_set readable;
+  FD_ZERO(&readable);
+  FD_SET(_socket, &readable);
+  struct timeval tv;
+  tv.tv_sec = wait / 1000;
+  tv.tv_usec = (wait % 1000) * 1000;
+  if (select(_socket + 1, &readable, NULL, NULL, &tv) > 0) {
+    // t4: as close to the arrival as we can get without driver timestamps
+    int64_t t4 = _time.utc_us();
+    _answered += _receive(t4);
+  };
+  return _answered >= _asked || _time.uptime_ms() >= _deadline;
+};
+
+// pool names rotate, so look them up every round (this is our own task, it may block)
+void SNTPClient::_resolve() {
+#ifdef SOAK
+  _soak->round();
+#endif
+  for (int i = 0; i < _n; i++) {
+#ifdef SOAK
+    // a failed lookup keeps the last address, as below
+    uint32_t addr = _soak->resolve(i);
+    if (addr != 0) {
+      _addr[i] = addr;
+    };
+#else
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    struct addrinfo *res = NULL;
+    if (getaddrinfo(_servers[i], NULL, &hints, &res) == 0 && res != NULL) {
+      _addr[i] = ((struct sockaddr_in *)res->ai_addr)->sin_addr.s_addr;
+    };
+    if (res != NULL) {
+      freeaddrinfo(res);
+    };
+#endif
+  };
+};
+
+#ifdef COOPERATIVE
+// the next bit of the round's DNS, without blocking: true once every server is done.
+// A lookup lwIP has cached comes back straight away, the others call _dnsFound()
+// later (with NULL once lwIP gives up); a failed one keeps the last address
+bool SNTPClient::_resolveStep() {
+  while (_lookup < _n) {
+    if (!_lookupPending) {
+      ip_addr_t addr;
+      _lookupDone = false;
+      err_t err = dns_gethostbyname(_servers[_lookup], &addr, _dnsFound, this);
+      if (err == ERR_INPROGRESS) {
+        _lookupPending = true;
+        return false;
+      };
+      if (err == ERR_OK && IP_IS_V4(&addr)) {
+        _addr[_lookup] = ip_2_ip4(&addr)->addr;
+      };
+      _lookup++;
+      continue;
+    };
+    if (!_lookupDone) {
+      return false;
+    };
+    if (_lookupAddr != 0) {
+      _addr[_lookup] = _lookupAddr;
+    };
+    _lookupPending = false;
+    _lookup++;
+  };
+  return true;
+};
+
+// lwIP's answer, in its own thread
+void SNTPClient::_dnsFound(const char *name, const ip_addr_t *addr, void *arg) {
+  SNTPClient *self = (SNTPClient *)arg;
+  self->_lookupAddr = addr != NULL && IP_IS_V4(addr) ? ip_2_ip4(addr)->addr : 0;
+  self->_lookupDone = true;
+};
+#endif
+
+// client request: LI 0, version 4, mode 3; our clock goes into the transmit timestamp
+void SNTPClient::_send(int i) {
+  memset(_packet, 0, sizeof(_packet));
+  _packet[0] = (0 << 6) | (4 << 3) | 3;
+#ifdef SOAK
+  // the lookups took their time, even if the round takes none (see Soak.h)
+  _t1[i] = _time.utc_us() + _soak->lookupMicros();
+#else
+  _t1[i] = _time.utc_us();
+#endif
+  _sent[i] = _toNTP(_t1[i]);
+  _write64(&_packet[40], _sent[i]);
+
+#ifdef SOAK
+  _soak->request(i, _packet, _t1[i]);
+#else
+  struct sockaddr_in to;
+  memset(&to, 0, sizeof(to));
+  to.sin_family = AF_INET;
+  to.sin_port = htons(_port);
+  to.sin_addr.s_addr = _addr[i];
+  sendto(_socket, _packet, sizeof(_packet), 0, (struct sockaddr *)&to, sizeof(to));
+#endif
+};
+
+// every datagram waiting, all stamped t4; how many were usable answers to our requests
+// (one that waited for a late look gets a longer delay, the fastest pick sorts that out)
+int SNTPClient::_receive(int64_t t4) {
+  int usable = 0;
+  for (;;) {
+    struct sockaddr_in from;
+    socklen_t fromlen = sizeof(from);
+    int len = recvfrom(_socket, _packet, sizeof(_packet), MSG_DONTWAIT, (struct sockaddr *)&from, &fromlen);
+    if (len < 0) {
+      return usable;
+    };
+    if (len >= (int)sizeof(_packet) && _parse(from.sin_addr.s_addr, t4)) {
+      usable++;
+    };
+  };
+};
+
+// the reply in _packet, from that address, arrived at t4
+bool SNTPClient::_parse(uint32_t from, int64_t t4) {
+  uint8_t li = _packet[0] >> 6;
+  uint8_t mode = _packet[0] & 0x07;
+  uint8_t stratum = _packet[1];
+  uint64_t originate = _read64(&_packet[24]);
+  uint64_t receive = _read64(&_packet[32]);
+  uint64_t transmit = _read64(&_packet[40]);
+  // server mode, synchronised, not a kiss-o'-death, and an actual time in it
+  if (mode != 4 || li == 3 || stratum == 0 || stratum > 15 || receive == 0 || transmit == 0) {
+    return false;
+  };
+  for (int i = 0; i < _n; i++) {
+    // must be the answer to what we asked this server, late or spoofed ones don't match
+    if (_addr[i] == from && _sent[i] == originate && !_samples[i].valid) {
+      int64_t t2 = _fromNTP(receive);
+      int64_t t3 = _fromNTP(transmit);
+      _samples[i].offset_us = ((t2 - _t1[i]) + (t3 - t4)) / 2;
+      _samples[i].delay_us = (t4 - _t1[i]) - (t3 - t2);
+      _samples[i].valid = _samples[i].delay_us >= 0;
+#ifdef DEBUG
+      Serial.print("SNTP: ");
+      Serial.print(_servers[i]);
+      Serial.print(" offset ");
+      Serial.print((long)(_samples[i].offset_us / 1000));
+      Serial.print(" ms, delay ");
+      Serial.print((long)(_samples[i].delay_us / 1000));
+      Serial.println(" ms");
+#endif
+      return _samples[i].valid;
+    };
+  };
+  return false;
+};
+
+// the fastest round trip has the least room for asymmetry, go with that one
+void SNTPClient::_apply() {
+  // the median offset of the round (the middle two averaged for an even count)
+  int64_t sorted[SNTP_MAX_SERVERS];
+  int count = 0;
+  for (int i = 0; i < _n; i++) {
+    if (_samples[i].valid) {
+      int k = count++;
+      for (; k > 0 && sorted[k - 1] > _samples[i].offset_us; k--) {
+        sorted[k] = sorted[k - 1];
+      };
+      sorted[k] = _samples[i].offset_us;
+    };
+  };
+  if (count == 0) {
+    return;
+  };
+  int64_t median = (sorted[(count - 1) / 2] + sorted[count / 2]) / 2;
+  // smallest delay among the servers that agree with it; two that don't agree
+  // leave nobody, then only a clock that was never set takes the faster one
+  int best = -1;
+  int fallback = -1;
+  for (int i = 0; i < _n; i++) {
+    if (!_samples[i].valid) {
+      continue;
+    };
+    if (fallback < 0 || _samples[i].delay_us < _samples[fallback].delay_us) {
+      fallback = i;
+    };
+    int64_t off = _samples[i].offset_us - median;
+    if (off > SNTP_MAX_SPREAD * 1000LL || off < -SNTP_MAX_SPREAD * 1000LL) {
+      continue;
+    };
+    if (best < 0 || _samples[i].delay_us < _samples[best].delay_us) {
+      best = i;
+    };
+  };
+  if (best < 0) {
+    if (_time.isSet()) {
+      return;
+    };
+    best = fallback;
+  };
+  int64_t offset_us = _samples[best].offset_us;
+  int64_t offset_ms = (offset_us >= 0 ? offset_us + 500 : offset_us - 500) / 1000;
+  if (!_time.isSet() || offset_ms > SNTP_MAX_SLEW || offset_ms < -SNTP_MAX_SLEW) {
+    _time.set(_time.utc_ms() + offset_ms);
+  } else {
+    _time.slew((int32_t)offset_ms);
+  };
+  _offset_ms = (int32_t)(offset_ms > INT32_MAX ? INT32_MAX : offset_ms < INT32_MIN ? INT32_MIN : offset_ms);
+  _delay_ms = (int32_t)(_samples[best].delay_us / 1000);
+  _server = best;
+  _result = true;
+};
+
+// unix us -> NTP 32.32 (the era rolls over in 2036, the low 32 bits are all we send)
+uint64_t SNTPClient::_toNTP(int64_t unix_us) {
+  uint64_t sec = (uint64_t)(unix_us / 1000000) + SNTP_UNIX_OFFSET;
+  uint64_t frac = (((uint64_t)(unix_us % 1000000) << 32) + 999999) / 1000000;  // round up, so _fromNTP() gives back the same us
+  return ((sec & 0xFFFFFFFFULL) << 32) | frac;
+};
+
+// NTP 32.32 -> unix us; seconds below 2^31 are taken as era 1 (after 2036)
+int64_t SNTPClient::_fromNTP(uint64_t ntp) {
+  uint64_t sec = ntp >> 32;
+  uint64_t frac = ntp & 0xFFFFFFFFULL;
+  if (sec < 0x80000000ULL) {
+    sec += 0x100000000ULL;
+  };
+  return (int64_t)(sec - SNTP_UNIX_OFFSET) * 1000000 + (int64_t)((frac * 1000000) >> 32);
+};
+
+uint64_t SNTPClient::_read64(const uint8_t *p) {
+  uint64_t v = 0;
+  for (int i = 0; i < 8; i++) {
+    v = (v << 8) | p[i];
+  };
+  return v;
+};
+
+void SNTPClient::_write64(uint8_t *p, uint64_t v) {
+  for (int i = 7; i >= 0; i--) {
+    p[i] = v & 0xFF;
+    v >>= 8;
+  };
+};
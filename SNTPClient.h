@@ -0,0 +1,127 @@
+#ifndef SNTP_CLIENT_H
+#define SNTP_CLIENT_H
+
+/* SNTP client with sub-second offsets and round trip filtering.
+ *
+ * NTPClient gave us whole seconds from one server and no round trip compensation,
+ * so the face could flip up to a second (plus network delay) late. This client:
+ *
+ *   - asks every server in NTP_SERVERS, once per round
+ *   - keeps the full 64 bit NTP timestamps (32.32 fixed point since 1900)
+ *   - computes per reply, in us:
+ *       offset = ((t2 - t1) + (t3 - t4)) / 2
+ *       delay  = (t4 - t1) - (t3 - t2)
+ *   - drops kiss-o'-death, unsynchronised and unsolicited replies
+ *   - drops a reply whose offset is more than SNTP_MAX_SPREAD off the median of
+ *     the round (a falseticker), since a short round trip says nothing about
+ *     whether the server's clock is right
+ *   - applies the offset of the remaining reply with the smallest delay to the
+ *     TimeBase: slewed when within SNTP_MAX_SLEW, stepped otherwise
+ *
+ * update() only wakes the client's task (core 0) and returns; the round (DNS,
+ * requests, waiting in select()) happens there, so loop() never blocks on the
+ * network. Replies are timestamped right after select() wakes up, not when loop()
+ * gets around to looking.
+ *
+ * One UDP socket, fixed 48 byte packet buffers, no WiFiUDP (which allocates a
+ * buffer per received packet).
+ *
+ * tools/ntp_responder.py is a local NTP server with injectable latency, skew and
+ * packet loss to test against: put the laptop's IP into NTP_SERVERS, port in NTP_PORT.
+ *
+ * With COOPERATIVE (one core) there's no task: update() resolves and sends, and the
+ * caller keeps calling poll(), which looks for replies without waiting, until the
+ * round is over; waitForTime() calls it too, waiting in select(), so the boot round
+ * isn't wasted. DNS doesn't block either: lwIP's dns_gethostbyname() with a
+ * callback, a server at a time, each poll() starting the next lookup or looking
+ * whether the last one is back; the requests go out once all are.
+ * Untested on a one-core board so far, only on a host build against
+ * tools/ntp_responder.py; there are no timings from real hardware yet.
+ *
+ * Under SOAK there's no socket and no task: DNS, sendto() and recvfrom() go to the
+ * fake network in Soak.h, and update() runs the round right there, on virtual time.
+ */
+
+#include <Arduino.h>
+#include <lwip/dns.h>
+#include "TimeBase.h"
+
+#define SNTP_MAX_SERVERS 4
+#define SNTP_TIMEOUT 2000           // ms to wait for the replies of one round
+#define SNTP_TASK_STACK 4096        // getaddrinfo() wants a bit
+#define SNTP_TASK_CORE 0
+#define SNTP_MAX_SPREAD 100         // ms a server may be off the round's median
+#define SNTP_MAX_SLEW 1000          // ms, bigger offsets are stepped, see TimeBase.h
+#define SNTP_UNIX_OFFSET 2208988800UL  // s between 1900 (NTP) and 1970 (unix)
+
+class Soak;
+
+class SNTPClient {
+public:
+  SNTPClient(TimeBase &time, const char *const *servers, int n, uint16_t port);
+  void begin();
+  void update();
+  bool busy();
+  bool takeResult(int32_t &offset_ms, int32_t &delay_ms, int &server);
+  bool waitForTime(uint32_t timeout_ms);
+#ifdef COOPERATIVE
+  bool poll(uint32_t wait_ms = 0);
+#endif
+#ifdef SOAK
+  void soak(Soak &network);
+#endif
+private:
+  struct Sample {
+    bool valid;
+    int64_t offset_us;
+    int64_t delay_us;
+  };
+  TimeBase &_time;
+  const char *const *_servers;
+  int _n;
+  uint16_t _port;
+  int _socket;
+  TaskHandle_t _task;
+  volatile bool _busy;
+  volatile bool _result;
+  volatile int32_t _offset_ms;
+  volatile int32_t _delay_ms;
+  volatile int _server;
+  uint32_t _addr[SNTP_MAX_SERVERS];   // IPv4, network order, 0 = unresolved
+  uint64_t _sent[SNTP_MAX_SERVERS];   // transmit timestamp we sent, NTP format
+  int64_t _t1[SNTP_MAX_SERVERS];      // and the same instant in unix us
+  Sample _samples[SNTP_MAX_SERVERS];
+  uint8_t _packet[48];
+  int _asked;                         // requests out this round
+  int _answered;                      // usable replies in
+  uint64_t _deadline;                 // uptime ms the round gives up
+#ifdef COOPERATIVE
+  int _lookup;                        // server being resolved, _n: all done
+  bool _lookupPending;                // dns_gethostbyname() will call back
+  volatile bool _lookupDone;          // it did
+  volatile uint32_t _lookupAddr;      // with this, 0: failed
+#endif
+#ifdef SOAK
+  Soak *_soak;
+#endif
+  static void _taskMain(void *arg);
+  void _round();
+  void _start();
+  void _ask();
+  bool _collect(uint32_t wait_ms);
+  void _resolve();
+#ifdef COOPERATIVE
+  bool _resolveStep();
+  static void _dnsFound(const char *name, const ip_addr_t *addr, void *arg);
+#endif
+  void _send(int i);
+  int _receive(int64_t t4);
+  bool _parse(uint32_t from, int64_t t4);
+  void _apply();
+  static uint64_t _toNTP(int64_t unix_us);
+  static int64_t _fromNTP(uint64_t ntp);
+  static uint64_t _read64(const uint8_t *p);
+  static void _write64(uint8_t *p, uint64_t v);
+};
+
+#endif
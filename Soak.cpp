@@ -0,0 +1,345 @@
+/*
+ * This is Soak.cpp
+ */
+
+#include "WordClock.h"          // SOAK switch
+#ifdef SOAK
+
+// the run, hour by hour; windows may overlap
+static const SoakFault soakScript[] = {
+  // start h, hours, what, server, value
+  {  12,   6, SOAK_NTP_SKEW,   0,   2500 },  // one server 2.5 s ahead
+  {  30,   3, SOAK_NTP_ZERO,  -1,      0 },  // everybody sends zero timestamps
+  {  48,  30, SOAK_LINK_DOWN, -1,      0 },  // WiFi gone overnight and the next day
+  { 100,  12, SOAK_NTP_LOSS,  -1,     80 },  // most packets lost
+  { 150,  24, SOAK_NTP_DELAY, -1,    400 },  // asymmetric path, 200 ms NTP can't see
+  { 200,   8, SOAK_DNS_SLOW,  -1,   3000 },  // slow, but in time
+  { 220,   8, SOAK_DNS_SLOW,  -1,   8000 },  // resolver times out
+  { 300,  72, SOAK_LINK_DOWN, -1,      0 },  // a long weekend without WiFi
+  { 400, 100, SOAK_NTP_LOSS,   1,    100 },  // one server dead for days
+  { 500,   2, SOAK_NTP_SKEW,  -1, -90000 },  // everybody 90 s behind: the face goes back
+  { 600,  48, SOAK_NTP_LOSS,  -1,    100 },  // NTP timeouts for two days
+  { 700,   1, SOAK_LINK_DOWN, -1,      0 },  // short outages, one after the other
+  { 702,   1, SOAK_LINK_DOWN, -1,      0 },
+  { 704,   1, SOAK_LINK_DOWN, -1,      0 },
+  { 800,  24, SOAK_NTP_SKEW,   2,   -700 },  // one server a bit behind: the odd one out, dropped
+  { 900,  10, SOAK_LINK_DOWN, -1,      0 },  // and a link that comes back to a late sync
+  { 900,  30, SOAK_NTP_LOSS,  -1,    100 },
+};
+#define SOAK_SCRIPT_LEN (sizeof(soakScript) / sizeof(soakScript[0]))
+
+// unix us -> NTP 32.32, big endian, as the server would put it on the wire
+static void soakNTP(uint8_t *p, int64_t unix_us) {
+  uint64_t sec = (uint64_t)(unix_us / 1000000) + SNTP_UNIX_OFFSET;
+  uint64_t frac = ((uint64_t)(unix_us % 1000000) << 32) / 1000000;
+  uint64_t v = ((sec & 0xFFFFFFFFULL) << 32) | frac;
+  for (int i = 7; i >= 0; i--) {
+    p[i] = v & 0xFF;
+    v >>= 8;
+  };
+};
+
+Soak::Soak() {
+  _time = NULL;
+  _upStart = 0;
+  _trueStart = 0;
+  _rng = SOAK_SEED;
+  memset(_replies, 0, sizeof(_replies));
+  _faulted = false;
+  _recovering = false;
+  _recoverySynced = false;
+  _faultEnd = 0;
+  _faults = 0;
+  _recoveries = 0;
+  _worstRecovery = 0;
+  _syncs = 0;
+  _lookup_ms = 0;
+  _worstLookup = 0;
+  _lookupTimeouts = 0;
+  _worstStall = 0;
+  _nearMisses = 0;
+  _resets = 0;
+  _lastMinute = -1;
+  _flips = 0;
+  _missed = 0;
+  _backwards = 0;
+  _late = 0;
+  _early = 0;
+  _lateSynced = 0;
+  _lastSync = 0;
+  _outageLate = 0;
+  _worstOutageLate = 0;
+  _worstFlip = 0;
+  _worstError = 0;
+};
+
+// after TimeWarp::begin(): the clock starts out right, and drifts from there
+void Soak::begin(TimeBase &time) {
+  _time = &time;
+  _upStart = time.uptime_ms();
+  _lastSync = _upStart;         // as good as a sync
+  _trueStart = time.utc_ms();
+  Serial.print("# soak: ");
+  Serial.print((unsigned long)SOAK_SCRIPT_LEN);
+  Serial.print(" faults over ");
+  Serial.print(SOAK_DAYS);
+  Serial.println(" days");
+};
+
+bool Soak::linkUp() {
+  return _active(SOAK_LINK_DOWN, -1) == NULL;
+};
+
+// an SNTP round starts with its lookups
+void Soak::round() {
+  _lookup_ms = 0;
+};
+
+// the server's address, 0 if the lookup failed (SNTPClient keeps the old one then)
+uint32_t Soak::resolve(int server) {
+  if (!linkUp()) {
+    return 0;
+  };
+  const SoakFault *dns = _active(SOAK_DNS_SLOW, server);
+  if (dns == NULL) {
+    return server + 1;
+  };
+  // one lookup after the other, each until it's answered or lwIP gives up
+  _lookup_ms += dns->value < SOAK_DNS_TIMEOUT ? dns->value : SOAK_DNS_TIMEOUT;
+  if (_lookup_ms > _worstLookup) {
+    _worstLookup = _lookup_ms;
+  };
+  if (dns->value > SOAK_DNS_TIMEOUT) {
+    _lookupTimeouts++;
+    return 0;
+  };
+  return server + 1;
+};
+
+// how far past update() the round's requests go out: the round takes no virtual time
+// of its own, so its lookups are added to the send time instead
+int64_t Soak::lookupMicros() {
+  return _lookup_ms * 1000LL;
+};
+
+// a request on its way: work out the reply, and when it gets back to us
+void Soak::request(int server, const uint8_t *packet, int64_t t1_us) {
+  if (!linkUp() || _lost()) {
+    return;
+  };
+  const SoakFault *loss = _active(SOAK_NTP_LOSS, server);
+  if (loss != NULL && (int32_t)(_random() % 100) < loss->value) {
+    return;
+  };
+  const SoakFault *delay = _active(SOAK_NTP_DELAY, server);
+  const SoakFault *skew = _active(SOAK_NTP_SKEW, server);
+  int64_t out_us = SOAK_RTT * 500LL + (delay != NULL ? delay->value * 1000LL : 0);
+  int64_t back_us = SOAK_RTT * 500LL;
+  if ((out_us + back_us) / 1000 > SNTP_TIMEOUT) {
+    return;  // the round is over by the time it gets here
+  };
+  // t2 = t3: the server's clock when the request arrives, sent after the lookups
+  int64_t t2 = (_true_ms() + _lookup_ms + (skew != NULL ? skew->value : 0)) * 1000 + out_us;
+  Reply &r = _replies[server];
+  memset(r.packet, 0, sizeof(r.packet));
+  r.packet[0] = (0 << 6) | (4 << 3) | 4;  // LI 0, version 4, server
+  r.packet[1] = 2;                        // stratum
+  memcpy(&r.packet[24], &packet[40], 8);  // originate = their transmit
+  if (_active(SOAK_NTP_ZERO, server) == NULL) {
+    soakNTP(&r.packet[32], t2);
+    soakNTP(&r.packet[40], t2);
+  };
+  r.from = server + 1;
+  r.t4_us = t1_us + out_us + back_us;
+  r.valid = true;
+};
+
+// the next reply to arrive, false once there are none left
+bool Soak::reply(uint8_t *packet, uint32_t &from, int64_t &t4_us) {
+  int next = -1;
+  for (int i = 0; i < SNTP_MAX_SERVERS; i++) {
+    if (_replies[i].valid && (next < 0 || _replies[i].t4_us < _replies[next].t4_us)) {
+      next = i;
+    };
+  };
+  if (next < 0) {
+    return false;
+  };
+  memcpy(packet, _replies[next].packet, sizeof(_replies[next].packet));
+  from = _replies[next].from;
+  t4_us = _replies[next].t4_us;
+  _replies[next].valid = false;
+  return true;
+};
+
+// the face went to a new minute: the one after the last, and on time?
+void Soak::flip() {
+  int64_t minute = _time->utc_ms() / 60000;
+  if (_lastMinute >= 0 && minute != _lastMinute) {
+    _flips++;
+    if (minute < _lastMinute) {
+      _backwards++;
+    } else {
+      _missed += minute - _lastMinute - 1;
+      int32_t off = _true_ms() - minute * 60000;  // > 0: late
+      if (abs(off) > abs(_worstFlip)) {
+        _worstFlip = off;
+      };
+      if (off > SOAK_LATE_MS) {
+        _late++;
+        if ((int64_t)(_time->uptime_ms() - _lastSync) < SOAK_DRIFT_LATE) {
+          _lateSynced++;
+        };
+        _outageLate++;
+        if (_outageLate > _worstOutageLate) {
+          _worstOutageLate = _outageLate;
+        };
+      } else if (off < -SOAK_LATE_MS) {
+        _early++;
+      };
+    };
+  };
+  _lastMinute = minute;
+};
+
+// NTP applied this server's offset; once that (stepped or slewed) has us back
+// after a fault, tick() counts the recovery
+void Soak::synced() {
+  _syncs++;
+  _lastSync = _time->uptime_ms();
+  _outageLate = 0;
+  if (_recovering) {
+    _recoverySynced = true;
+  };
+};
+
+// once per loop(): fault windows opening and closing, clock error, stalls
+void Soak::tick(uint32_t stall_ms) {
+  uint32_t h = _hour();
+  bool faulted = false;
+  for (unsigned i = 0; i < SOAK_SCRIPT_LEN; i++) {
+    if (h >= soakScript[i].start && h < (uint32_t)soakScript[i].start + soakScript[i].hours) {
+      faulted = true;
+    };
+  };
+  if (faulted && !_faulted) {
+    _faults++;
+  } else if (!faulted && _faulted) {
+    _recovering = true;
+    _recoverySynced = false;
+    _faultEnd = _time->uptime_ms();
+  };
+  _faulted = faulted;
+
+  int32_t error = _time->utc_ms() - _true_ms();
+  if (_recovering && _recoverySynced && abs(error) <= SOAK_SYNC_MS) {
+    uint32_t s = (_time->uptime_ms() - _faultEnd) / 1000;
+    if (s > _worstRecovery) {
+      _worstRecovery = s;
+    };
+    _recoveries++;
+    _recovering = false;
+  };
+  if (abs(error) > abs(_worstError)) {
+    _worstError = error;
+  };
+  if (stall_ms > _worstStall) {
+    _worstStall = stall_ms;
+  };
+  if (stall_ms > WDT_TIMEOUT * 1000UL) {
+    _resets++;
+  } else if (stall_ms > WDT_NEAR_MISS) {
+    _nearMisses++;
+  };
+};
+
+void Soak::report() {
+  // a fault we never came back from counts until the end of the run
+  if (_recovering) {
+    uint32_t s = (_time->uptime_ms() - _faultEnd) / 1000;
+    if (s > _worstRecovery) {
+      _worstRecovery = s;
+    };
+  };
+  char buf[128];
+  snprintf(buf, sizeof(buf), "# soak: %lu fault windows, %lu recovered, worst %lu s; %lu syncs, clock error worst %ld ms",
+           (unsigned long)_faults, (unsigned long)_recoveries, (unsigned long)_worstRecovery,
+           (unsigned long)_syncs, (long)_worstError);
+  Serial.println(buf);
+  snprintf(buf, sizeof(buf), "# soak: loop stall worst %lu ms, %lu near misses, %lu watchdog resets",
+           (unsigned long)_worstStall, (unsigned long)_nearMisses, (unsigned long)_resets);
+  Serial.println(buf);
+  snprintf(buf, sizeof(buf), "# soak: %lu flips, %lu missed, %lu backwards, %lu late, %lu early, worst %ld ms off",
+           (unsigned long)_flips, (unsigned long)_missed, (unsigned long)_backwards,
+           (unsigned long)_late, (unsigned long)_early, (long)_worstFlip);
+  Serial.println(buf);
+  snprintf(buf, sizeof(buf), "# soak: DNS worst %lu ms in one round, %lu lookups timed out",
+           (unsigned long)_worstLookup, (unsigned long)_lookupTimeouts);
+  Serial.println(buf);
+  snprintf(buf, sizeof(buf), "# soak: late: %lu within %lu min of a sync, worst outage %lu",
+           (unsigned long)_lateSynced, (unsigned long)(SOAK_DRIFT_LATE / 60000), (unsigned long)_worstOutageLate);
+  Serial.println(buf);
+
+  bool pass = true;
+  pass &= _budget("recovery s", _worstRecovery, SOAK_MAX_RECOVERY);
+  pass &= _budget("stall ms", _worstStall, SOAK_MAX_STALL);
+  pass &= _budget("near misses", _nearMisses, SOAK_MAX_NEAR_MISS);
+  pass &= _budget("watchdog resets", _resets, SOAK_MAX_RESETS);
+  pass &= _budget("missed", _missed, SOAK_MAX_MISSED);
+  pass &= _budget("backwards", _backwards, SOAK_MAX_BACKWARDS);
+  pass &= _budget("late in one outage", _worstOutageLate, SOAK_MAX_LATE_OUTAGE);
+  pass &= _budget("late, not drift", _lateSynced, SOAK_MAX_LATE_SYNCED);
+  pass &= _budget("early", _early, SOAK_MAX_EARLY);
+  pass &= _budget("DNS ms", _worstLookup, SOAK_MAX_LOOKUP);
+  Serial.println(pass ? "# soak PASS" : "# soak FAIL");
+};
+
+// true time: started out equal to ours, runs SOAK_DRIFT_PPM faster
+int64_t Soak::_true_ms() {
+  int64_t up = _time->uptime_ms() - _upStart;
+  return _trueStart + up + up * SOAK_DRIFT_PPM / 1000000;
+};
+
+uint32_t Soak::_hour() {
+  return (_time->uptime_ms() - _upStart) / 3600000UL;
+};
+
+// the first fault of this kind that's on right now and hits this server
+const SoakFault *Soak::_active(SoakFaultKind kind, int server) {
+  uint32_t h = _hour();
+  for (unsigned i = 0; i < SOAK_SCRIPT_LEN; i++) {
+    const SoakFault &f = soakScript[i];
+    if (f.kind == kind && (f.server < 0 || server < 0 || f.server == server) &&
+        h >= f.start && h < (uint32_t)f.start + f.hours) {
+      return &f;
+    };
+  };
+  return NULL;
+};
+
+// the odd packet goes missing on a good day too
+bool Soak::_lost() {
+  return _random() % 1000 == 0;
+};
+
+uint32_t Soak::_random() {
+  _rng ^= _rng << 13;
+  _rng ^= _rng >> 17;
+  _rng ^= _rng << 5;
+  return _rng;
+};
+
+bool Soak::_budget(const char *what, uint32_t value, uint32_t max) {
+  if (value <= max) {
+    return true;
+  };
+  Serial.print("# soak FAIL: ");
+  Serial.print(what);
+  Serial.print(' ');
+  Serial.print((unsigned long)value);
+  Serial.print(" > ");
+  Serial.println((unsigned long)max);
+  return false;
+};
+
+#endif  // SOAK
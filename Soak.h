@@ -0,0 +1,150 @@
+#ifndef SOAK_H
+#define SOAK_H
+
+/* Soak test under fault injection (#define SOAK in WordClock.h, implies TIME_WARP).
+ *
+ * What goes wrong in the field is WiFi gone for hours, NTP timeouts, slow DNS and
+ * the clock jumping when a sync finally comes through; none of it happens on demand.
+ * So: time warp (weeks of loop() in minutes on the virtual clock), with the real
+ * SNTPClient and _ensure_wifi() talking to a fake network instead of lwIP:
+ *
+ *   - the link, for _ensure_wifi() and the WiFi symbol
+ *   - DNS, which can fail or be slower than the resolver's timeout; the lookups hold
+ *     up the round they're in (the requests go out that much later on virtual time,
+ *     as in SNTPClient's task), and the worst round's lookups are reported
+ *   - the NTP servers, which answer from a "true" clock running SOAK_DRIFT_PPM ahead
+ *     of our crystal, after SOAK_RTT ms, and can lose, delay (one way only, which
+ *     NTP can't tell from an offset), skew or zero their replies
+ *
+ * The faults come from a script in Soak.cpp: start hour, hours, what, which server.
+ * Packet loss is drawn from a fixed seed, so every run of the same firmware sees the
+ * same network and gives the same numbers.
+ *
+ * Measured against the true clock, over the whole run:
+ *   recovery   from the end of a fault until a sync has us within SOAK_SYNC_MS (a
+ *              slewed one only once it's in)
+ *   stall      virtual ms in one loop() (not counting the sleep to the next second);
+ *              over WDT_NEAR_MISS is a near miss, over WDT_TIMEOUT a watchdog reset
+ *   flips      minutes the face skipped, showed twice (clock went back), or flipped
+ *              more than SOAK_LATE_MS late or early; late ones are split into those
+ *              drift explains (SOAK_DRIFT_LATE or longer since the last sync) and
+ *              the rest, and the drift ones are counted per outage, sync to sync
+ *
+ * report() prints all that after the time warp summary, then "# soak PASS", or
+ * "# soak FAIL" and every budget below that was exceeded. Each budget is worked out
+ * from the script and the constants here (next to it), so a change to either wants
+ * the budget worked out again; the "# soak" lines of a run show how close it came.
+ */
+
+#include <Arduino.h>
+#include "TimeBase.h"
+#include "SNTPClient.h"
+
+#define SOAK_DAYS 42            // the script in Soak.cpp fits into six weeks
+#define SOAK_DRIFT_PPM 40       // true time runs this much faster than our crystal
+#define SOAK_RTT 30             // ms round trip to an NTP server on a good day
+#define SOAK_DNS_TIMEOUT 5000   // ms, lwIP gives up on a lookup after this
+#define SOAK_SYNC_MS 250        // |clock - true| that counts as in sync
+#define SOAK_LATE_MS 1000       // a flip this far off the true minute is late (early)
+#define SOAK_SEED 0x50A4C10C    // xorshift32, for packet loss
+// ms after a sync until drift alone puts us SOAK_LATE_MS behind, ~6.9 h
+#define SOAK_DRIFT_LATE (SOAK_LATE_MS * 1000000LL / SOAK_DRIFT_PPM)
+
+// regression budgets, report() fails the run on anything over these
+// s: NTP only asks once an hour, and an offset that's slewed (up to SNTP_MAX_SLEW)
+// takes TIME_SLEW_RATE ms per ms to get within SOAK_SYNC_MS: 3600 + 750 * 2 = 5100
+#define SOAK_MAX_RECOVERY 5100
+#define SOAK_MAX_STALL 10000    // ms, _ensure_wifi() waits WIFI_WAIT for the link
+#define SOAK_MAX_NEAR_MISS 0
+#define SOAK_MAX_RESETS 0
+#define SOAK_MAX_MISSED 1       // the 90 s skew in the script: back a minute, then over one
+#define SOAK_MAX_BACKWARDS 1
+// late flips in one outage: the longest without NTP is the 72 h weekend, plus up to
+// SOAK_MAX_RECOVERY to the next sync, less SOAK_DRIFT_LATE: (72 h + 5100 s - 6.94 h) * 60
+#define SOAK_MAX_LATE_OUTAGE 3990
+// late flips drift can't explain: everybody 90 s off for 2 h, and up to an hour
+// after to the next round, (2 + 1) * 60
+#define SOAK_MAX_LATE_SYNCED 180
+#define SOAK_MAX_EARLY 0
+#define SOAK_MAX_LOOKUP (SNTP_MAX_SERVERS * SOAK_DNS_TIMEOUT)  // ms a round waits for DNS, all time out
+
+enum SoakFaultKind : uint8_t {
+  SOAK_LINK_DOWN,               // no WiFi
+  SOAK_NTP_LOSS,                // value: % of requests or replies lost
+  SOAK_NTP_DELAY,               // value: ms more on the way to the server only
+  SOAK_NTP_SKEW,                // value: ms the server's clock is off
+  SOAK_NTP_ZERO,                // server answers with zero timestamps
+  SOAK_DNS_SLOW                 // value: ms a lookup takes, over SOAK_DNS_TIMEOUT fails
+};
+
+struct SoakFault {
+  uint16_t start;               // h into the run
+  uint16_t hours;
+  SoakFaultKind kind;
+  int8_t server;                // index into NTP_SERVERS, -1: all of them
+  int32_t value;
+};
+
+class Soak {
+public:
+  Soak();
+  void begin(TimeBase &time);
+  // the fake network, for _ensure_wifi() and SNTPClient
+  bool linkUp();
+  void round();
+  uint32_t resolve(int server);
+  int64_t lookupMicros();
+  void request(int server, const uint8_t *packet, int64_t t1_us);
+  bool reply(uint8_t *packet, uint32_t &from, int64_t &t4_us);
+  // what loop() did
+  void flip();
+  void synced();
+  void tick(uint32_t stall_ms);
+  void report();
+private:
+  struct Reply {
+    bool valid;
+    uint32_t from;
+    int64_t t4_us;              // arrival, on our clock
+    uint8_t packet[48];
+  };
+  TimeBase *_time;
+  uint64_t _upStart;            // uptime at begin()
+  int64_t _trueStart;           // true UTC ms then
+  uint32_t _rng;
+  Reply _replies[SNTP_MAX_SERVERS];
+  bool _faulted;
+  bool _recovering;
+  bool _recoverySynced;         // NTP came through since the fault ended
+  uint64_t _faultEnd;           // uptime ms the last fault window closed
+  uint32_t _faults;
+  uint32_t _recoveries;
+  uint32_t _worstRecovery;      // s
+  uint32_t _syncs;
+  uint32_t _lookup_ms;          // DNS time of the round so far
+  uint32_t _worstLookup;        // ms, one round
+  uint32_t _lookupTimeouts;
+  uint32_t _worstStall;         // ms
+  uint32_t _nearMisses;
+  uint32_t _resets;
+  int64_t _lastMinute;          // shown by the last flip, -1: none yet
+  uint32_t _flips;
+  uint32_t _missed;
+  uint32_t _backwards;
+  uint32_t _late;
+  uint32_t _early;
+  uint32_t _lateSynced;         // late with the last sync less than SOAK_DRIFT_LATE ago
+  uint64_t _lastSync;           // uptime ms
+  uint32_t _outageLate;         // late since then
+  uint32_t _worstOutageLate;
+  int32_t _worstFlip;           // ms, signed, furthest from the true minute
+  int32_t _worstError;          // ms, clock - true
+  int64_t _true_ms();
+  uint32_t _hour();
+  const SoakFault *_active(SoakFaultKind kind, int server);
+  bool _lost();
+  uint32_t _random();
+  bool _budget(const char *what, uint32_t value, uint32_t max);
+};
+
+#endif
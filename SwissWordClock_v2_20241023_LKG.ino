@@ -9,10 +9,9 @@
  *   https://github.com/signetica/MoonPhase
  *   https://github.com/JChristensen/Timezone
  *   https://github.com/PaulStoffregen/Time
- *   https://github.com/arduino-libraries/NTPClient
  *   https://iotassistant.io/esp32/enable-hardware-watchdog-timer-esp32-arduino-ide/
  * 
- * TimeLib etc. - the code basically runs everything in UTC, takes now() from NTPClient,
+ * TimeLib etc. - the code basically runs everything in UTC, takes its time from NTP (SNTPClient),
  * and converts time to Sydney local timezone and DST where and when required.
  *
  * Character pattern kept at 12x12=144 LEDs, but changed from Bern Swiss German 
@@ -53,7 +52,11 @@ WordClock wordClock;
  */
 void setup() {
   // put your setup code here, to run once:
+#ifdef TIME_WARP
+  Serial.begin(921600); // the time warp frame trace is chatty
+#else
   Serial.begin(9600); // 115200, 921600, 9600, 1200 (old skool #AT)
+#endif
   wordClock.begin();
 };
 
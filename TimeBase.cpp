@@ -0,0 +1,113 @@
+/*
+ * This is TimeBase.cpp
+ */
+
+#include "WordClock.h"          // TIME_WARP switch
+#include <esp_timer.h>
+
+TimeBase::TimeBase() {
+  _offset_us = 0;
+  _slew_us = 0;
+  _slewStart = 0;
+  _set = false;
+#ifdef TIME_WARP
+  _virtual_ms = 0;
+#endif
+};
+
+// ms since boot, 64 bit so no rollover to worry about
+uint64_t TimeBase::uptime_ms() {
+#ifdef TIME_WARP
+  return _virtual_ms;
+#else
+  return (uint64_t)(esp_timer_get_time() / 1000);
+#endif
+};
+
+int64_t TimeBase::_uptime_us() {
+#ifdef TIME_WARP
+  return (int64_t)_virtual_ms * 1000;
+#else
+  return esp_timer_get_time();
+#endif
+};
+
+// how much of the slew is in by then, 0.5 us per ms; call with _lock held
+int64_t TimeBase::_slewed(int64_t uptime_us) {
+  if (_slew_us == 0) {
+    return 0;
+  };
+  int64_t done = (uptime_us - _slewStart) / TIME_SLEW_RATE;
+  int64_t whole = _slew_us < 0 ? -_slew_us : _slew_us;
+  if (done > whole) {
+    done = whole;
+  };
+  return _slew_us < 0 ? -done : done;
+};
+
+// UTC epoch time in ms
+int64_t TimeBase::utc_ms() {
+  return utc_us() / 1000;
+};
+
+// UTC epoch time in us, for timestamping network packets
+int64_t TimeBase::utc_us() {
+  int64_t up = _uptime_us();
+  portENTER_CRITICAL(&_lock);
+  int64_t offset = _offset_us + _slewed(up);
+  portEXIT_CRITICAL(&_lock);
+  return up + offset;
+};
+
+// UTC epoch time in s, drop-in for TimeLib's now()
+time_t TimeBase::utc() {
+  return (time_t)(utc_ms() / 1000);
+};
+
+// hard set, e.g. from an NTP reply
+void TimeBase::set(int64_t utc_ms) {
+  int64_t offset = utc_ms * 1000 - _uptime_us();
+  portENTER_CRITICAL(&_lock);
+  _offset_us = offset;
+  _slew_us = 0;
+  _set = true;
+  portEXIT_CRITICAL(&_lock);
+};
+
+// small correction, e.g. from the LAN sync leader
+void TimeBase::adjust(int32_t delta_ms) {
+  portENTER_CRITICAL(&_lock);
+  _offset_us += (int64_t)delta_ms * 1000;
+  portEXIT_CRITICAL(&_lock);
+};
+
+// small NTP correction, taken in gradually instead of in one step
+void TimeBase::slew(int32_t delta_ms) {
+  int64_t up = _uptime_us();
+  portENTER_CRITICAL(&_lock);
+  _offset_us += _slewed(up);
+  _slew_us = (int64_t)delta_ms * 1000;
+  _slewStart = up;
+  portEXIT_CRITICAL(&_lock);
+};
+
+bool TimeBase::isSet() {
+  return _set;
+};
+
+// how long until the next whole UTC second (1..1000 ms)
+int32_t TimeBase::msToNextSecond() {
+  return 1000 - (int32_t)(utc_ms() % 1000);
+};
+
+#ifdef TIME_WARP
+// jump the virtual uptime, e.g. to just before it needs more than 32 bits
+void TimeBase::warpTo(uint64_t uptime_ms) {
+  _virtual_ms = uptime_ms;
+};
+
+// what delay() would have done, minus the waiting
+void TimeBase::advance(uint32_t ms) {
+  _virtual_ms += ms;
+};
+#endif
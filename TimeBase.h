@@ -0,0 +1,58 @@
+#ifndef TIME_BASE_H
+#define TIME_BASE_H
+
+/* Millisecond UTC clock for the WordClock.
+ *
+ * TimeLib's now() only knows whole seconds and the clock face used to poll it once a
+ * second, so the minute flip could land anywhere in that second. TimeBase keeps UTC as
+ * an offset (in us) from the 64 bit esp_timer uptime, which doesn't roll over like
+ * millis() does after 49.7 days. NTP sets it, LAN sync nudges it, and loop() sleeps
+ * until the next whole second so the face flips on the minute boundary.
+ *
+ * A small NTP correction is slewed, not stepped: slew() takes it in at one ms per
+ * TIME_SLEW_RATE ms of uptime, so the clock only runs a little slower or faster
+ * and never goes back (a backward step just after :00 would flip the face back a
+ * minute). A slew still going when the next one comes is replaced by it, since
+ * the next NTP round measures what's left of it anyway.
+ *
+ * It is read from loop() on core 1 and written by the sync task on core 0, so the
+ * offset is guarded by a spinlock.
+ *
+ * In TIME_WARP mode the uptime is virtual: it only moves when loop() calls advance().
+ */
+
+#include <Arduino.h>
+#include <time.h>
+
+#define TIME_SLEW_RATE 2000     // ms of uptime per ms slewed (500 ppm, ntpd's limit): 1 s in ~33 min
+
+class TimeBase {
+public:
+  TimeBase();
+  uint64_t uptime_ms();
+  int64_t utc_ms();
+  int64_t utc_us();
+  time_t utc();
+  void set(int64_t utc_ms);
+  void adjust(int32_t delta_ms);
+  void slew(int32_t delta_ms);
+  bool isSet();
+  int32_t msToNextSecond();
+#ifdef TIME_WARP
+  void warpTo(uint64_t uptime_ms);
+  void advance(uint32_t ms);
+#endif
+private:
+  int64_t _offset_us;   // utc - uptime, not counting the slew so far
+  int64_t _slew_us;     // the whole correction being slewed in, signed
+  int64_t _slewStart;   // uptime us it started
+#ifdef TIME_WARP
+  uint64_t _virtual_ms;
+#endif
+  bool _set;
+  int64_t _uptime_us();
+  int64_t _slewed(int64_t uptime_us);
+  portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
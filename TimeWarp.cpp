@@ -0,0 +1,133 @@
+/*
+ * This is TimeWarp.cpp
+ */
+
+#include "WordClock.h"          // TIME_WARP switch
+#ifdef TIME_WARP
+
+TimeWarp::TimeWarp() {
+  _last.clear();
+  _lastChange = 0;
+  _day = 0;
+  _lastLocal = 0;
+  _dayFrames = 0;
+  _dayMicros = 0;
+  _totalMicros = 0;
+  _traceLen = 0;
+  _loopTraceMicros = 0;
+  _dayTraceMicros = 0;
+  _totalTraceMicros = 0;
+  _totalFrames = 0;
+  _loops = 0;
+  _checksum = 2166136261UL;  // FNV-1a offset basis
+  _finished = false;
+};
+
+// put the virtual clock at the start of the run
+void TimeWarp::begin(TimeBase &time) {
+  time.warpTo(WARP_UPTIME_START);
+  time.set(WARP_START * 1000LL);
+  _lastChange = WARP_START;
+  Serial.println("# time warp");
+};
+
+// one line per frame change: seconds since the last one, then the toggled pixels
+void TimeWarp::frame(const FrameMask &f, time_t utc) {
+  if (f == _last) {
+    return;
+  };
+  FrameMask diff = f ^ _last;
+  char line[WARP_LINE_MAX];
+  int n = snprintf(line, sizeof(line), "F %lu ", (unsigned long)(utc - _lastChange));
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    if (diff.test(p)) {
+      n += snprintf(line + n, sizeof(line) - n, "%02X", p);
+    };
+  };
+  _print(line);
+
+  // FNV-1a over the time and the new frame
+  uint32_t v = (uint32_t)utc;
+  for (int b = 0; b < 4; b++) {
+    _checksum = (_checksum ^ ((v >> (8 * b)) & 0xFF)) * 16777619UL;
+  };
+  for (int i = 0; i < FRAME_MASK_WORDS; i++) {
+    for (int b = 0; b < 4; b++) {
+      _checksum = (_checksum ^ ((f.w[i] >> (8 * b)) & 0xFF)) * 16777619UL;
+    };
+  };
+  _last = f;
+  _lastChange = utc;
+  _dayFrames++;
+  _totalFrames++;
+};
+
+// account for one pass through loop() (less any trace it wrote out), close the
+// simulated (local) day when it's over
+void TimeWarp::tick(time_t utc, time_t local, uint32_t loop_us) {
+  _loops++;
+  loop_us -= _loopTraceMicros < loop_us ? _loopTraceMicros : loop_us;
+  _dayMicros += loop_us;
+  _totalMicros += loop_us;
+  if (_lastLocal != 0 && day(local) != day(_lastLocal)) {
+    char buf[96];
+    snprintf(buf, sizeof(buf), "# day %lu %04d-%02d-%02d cpu %llu trace %llu frames %lu",
+             (unsigned long)_day, year(_lastLocal), month(_lastLocal), day(_lastLocal),
+             (unsigned long long)_dayMicros, (unsigned long long)_dayTraceMicros,
+             (unsigned long)_dayFrames);
+    _print(buf);
+    _flush();
+    _day++;
+    _dayMicros = 0;
+    _dayTraceMicros = 0;
+    _dayFrames = 0;
+  };
+  _loopTraceMicros = 0;
+  _lastLocal = local;
+  if (_day >= WARP_DAYS) {
+    _finished = true;
+  };
+};
+
+bool TimeWarp::finished() {
+  return _finished;
+};
+
+void TimeWarp::report() {
+  _flush();
+  char buf[128];
+  snprintf(buf, sizeof(buf), "# done: %lu days, %lu frames, %llu loops, %llu us cpu/day, %llu us trace/day, checksum %08lx",
+           (unsigned long)_day, (unsigned long)_totalFrames, (unsigned long long)_loops,
+           (unsigned long long)(_day ? _totalMicros / _day : _totalMicros),
+           (unsigned long long)(_day ? _totalTraceMicros / _day : _totalTraceMicros), (unsigned long)_checksum);
+  Serial.println(buf);
+};
+
+// a line into the trace buffer, written out first if it doesn't fit any more
+void TimeWarp::_print(const char *line) {
+  size_t n = strlen(line);
+  if (_traceLen + n + 2 > WARP_TRACE_BUF) {
+    _flush();
+  };
+  memcpy(_trace + _traceLen, line, n);
+  _trace[_traceLen + n] = '\r';
+  _trace[_traceLen + n + 1] = '\n';
+  _traceLen += n + 2;
+};
+
+// out to Serial, timed: that's UART time, not clock time
+void TimeWarp::_flush() {
+  if (_traceLen == 0) {
+    return;
+  };
+  unsigned long start = micros();
+  Serial.write((const uint8_t *)_trace, _traceLen);
+  Serial.flush();
+  uint32_t us = micros() - start;
+  _traceLen = 0;
+  _loopTraceMicros += us;
+  _dayTraceMicros += us;
+  _totalTraceMicros += us;
+};
+
+#endif  // TIME_WARP
@@ -0,0 +1,72 @@
+#ifndef TIME_WARP_H
+#define TIME_WARP_H
+
+/* Time-warp mode (#define TIME_WARP in WordClock.h).
+ *
+ * The clock runs its normal WordClock::loop(), but TimeBase runs on a virtual uptime
+ * that loop() advances instead of sleeping, and there is no WiFi, NTP or LED output.
+ * That way years of DST changes, Easters, Christmases, leap days and year boundaries
+ * go past in minutes. The virtual uptime starts an hour before 2^32 ms, so anything
+ * that keeps TimeBase::uptime_ms() in 32 bits breaks straight away. That's all it
+ * catches: millis() isn't virtual and won't roll over in a run. So nothing that
+ * runs in TIME_WARP times itself with millis(); the clock code takes uptime_ms()
+ * (loop()'s watchdog near-miss check, SNTPClient's waits), and what's left on
+ * millis() (OTA download, Dither's rate) is off here and only ever subtracts.
+ *
+ * Output on the Serial port (921600 baud), one line per frame change:
+ *   F <seconds since last change> <toggled pixel ids, 2 hex digits each>
+ * and one line per simulated day:
+ *   # day <n> <yyyy-mm-dd> cpu <us> trace <us> frames <n>
+ * finishing with a summary including an FNV-1a checksum over all frames, so two
+ * firmware versions can be compared by a single number.
+ *
+ * The trace is collected in RAM and written out in chunks of up to WARP_TRACE_BUF
+ * bytes, outside the time loop() is charged for: cpu is loop() alone, trace is what
+ * the UART took (at 921600 baud that's ~11 us a byte, far more than the clock).
+ */
+
+#include <Arduino.h>
+#include <TimeLib.h>
+#include "TimeBase.h"
+#include "FrameMask.h"
+
+#define WARP_START 1711760400UL         // Sat 30/03/2024 01:00 UTC: Easter, then the April DST change
+#ifdef SOAK
+#define WARP_DAYS SOAK_DAYS             // as long as the fault script, see Soak.h
+#else
+#define WARP_DAYS 1096                  // three years, incl. the 29/02/2028 leap day
+#endif
+#define WARP_UPTIME_START 4291367296ULL // 2^32 - 1h in ms, uptime_ms() passes 32 bits in an hour
+#define WARP_TRACE_BUF 2048             // bytes of trace held back before Serial sees them
+#define WARP_LINE_MAX (16 + 2 * NEO_PIXELS)  // longest "F" line, every pixel toggled
+
+class TimeWarp {
+public:
+  TimeWarp();
+  void begin(TimeBase &time);
+  void frame(const FrameMask &f, time_t utc);
+  void tick(time_t utc, time_t local, uint32_t loop_us);
+  bool finished();
+  void report();
+private:
+  FrameMask _last;
+  time_t _lastChange;
+  time_t _lastLocal;
+  uint32_t _day;
+  uint32_t _dayFrames;
+  uint64_t _dayMicros;
+  uint64_t _totalMicros;
+  char _trace[WARP_TRACE_BUF];
+  size_t _traceLen;
+  uint32_t _loopTraceMicros;        // written out during this loop(), not loop()'s cost
+  uint64_t _dayTraceMicros;
+  uint64_t _totalTraceMicros;
+  uint32_t _totalFrames;
+  uint64_t _loops;
+  uint32_t _checksum;
+  bool _finished;
+  void _print(const char *line);
+  void _flush();
+};
+
+#endif
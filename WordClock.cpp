@@ -4,19 +4,44 @@
 
 #include "WordClock.h"
 
-WiFiUDP ntpUDP;
-NTPClient ntpClient(ntpUDP, NTP_POOL, NTP_OFFSET, NTP_INTERVAL);
 TimeChangeRule AUDST{ "AUDST", First, Sun, Oct, 2, 660 };
 TimeChangeRule AUSTD{ "AUSTD", First, Sun, Apr, 3, 600 };
 Timezone Sydney(AUSTD, AUDST);
 TimeChangeRule *tcr;  // pointer to the time change rule, use to get TZ abbrev
 
-WordClock::WordClock(){
+#ifdef LAN_SYNC
+WordClock::WordClock() : _sync(_time) {
+#else
+WordClock::WordClock() {
+#endif
   // nothing to do here, it's just a stub
   // initialisation in WordClock::begin() below
 };
 
 void WordClock::begin() {
+#ifdef DITHER
+  // start refreshing the strip, it shows whatever _show() commits
+  _dither.begin();
+#elif !defined(TIME_WARP)
+  // set up the output now (NEO_SEGMENTS installs its RMT channels), not in loop()
+  _pixels.begin();
+#endif
+#ifdef OTA_UPDATE
+  // arm the rollback timer if this is a freshly updated image
+  _ota.begin();
+#endif
+
+#ifdef TIME_WARP
+  // no WiFi, no NTP: a virtual clock, advanced by loop() instead of sleeping
+  _warp.begin(_time);
+#ifdef SOAK
+  // ... with the real SNTP client, on a network that fails as the script says
+  _soak.begin(_time);
+  _sntp.soak(_soak);
+  _sntp.begin();
+#endif
+  time_t t = utc();
+#else
   // connect to WiFi
   WiFi.setHostname(HOSTNAME);
   WiFi.begin(WIFI_SSID, WIFI_PASS);
@@ -33,12 +58,40 @@ void WordClock::begin() {
 #endif
 
   // We can assume that we have WiFi
-  // so we're starting an NTP client, and update it
-  ntpClient.begin();   // start NTP client via UDP over WiFi
-  ntpClient.update();  // update the client (if necessary, see NTP_INTERVAL)
-  // we now have a sync, so we're resetting the time from 1/1/1970 to UTC epoch time
-  time_t t = ntpClient.getEpochTime();  // grab new updated time from client and sync with system time
-  setTime(t);                           // now the internal TimeLib clock is running at UTC
+  // so we're starting the SNTP client, and ask all servers for the time
+  _sntp.begin();
+  _sntp.update();
+  // the round runs on core 0, wait for it to set our millisecond time base
+  if (!_sntp.waitForTime(NTP_WAIT)) {
+#ifdef ECHO
+    Serial.println("No NTP reply, time will be set on the next round");
+#endif
+  };
+  time_t t = utc();
+  setTime(t);  // keep the TimeLib clock roughly right too, in case a library looks at it
+
+#ifdef LAN_SYNC
+  // find the other clocks on the LAN, elect a leader, follow it
+  _sync.begin();
+#endif
+#ifdef MQTT_STATE
+  // connects in the background, and again whenever the broker comes back
+  _mqtt.begin();
+#endif
+#ifdef FACE_MIRROR
+  // http://<clock>/ shows the face as it is
+  _mirror.begin();
+#endif
+#endif  // TIME_WARP
+
+#ifdef FLIGHT_RECORDER
+  // write out what the last run left in RTC memory, log this boot
+  _recorder.begin(_time);
+#endif
+#ifdef AMBIENT_LIGHT
+  // sampling task on core 0, the face follows the room from the first reading
+  _light.begin();
+#endif
 
   // update sunrise, moonrise, moonphase etc once an hour
   _sunrise.calculate(LATITUDE, LONGITUDE, t);   // t = EpochTime
@@ -62,33 +115,64 @@ void WordClock::begin() {
   // WDT_TIMEOUT is defined in WordClock.h, defaults to 30s
   esp_task_wdt_init(WDT_TIMEOUT, true);  //enable panic so ESP32 restarts
   esp_task_wdt_add(NULL);                //add current thread to WDT watch
+
+#ifdef COOPERATIVE
+  // loop() runs these from now on
+  _coopBegin();
+#endif
+
+#ifdef ALLOC_TRACK
+  // from here on loop() should not touch the heap, start counting
+  AllocTracker::begin();
+#endif
 };
 
 /*********************
  * WordClock methods *
  *********************/
 
+// UTC from our own time base (NTP, or the LAN sync leader)
+time_t WordClock::utc() {
+  return _time.utc();
+};
+
 // grab the day from the UTC time and convert to Sydney time
 int WordClock::get_day() {
-  time_t t = Sydney.toLocal(now());  // convert to local Sydney time (incl DST)
+  time_t t = Sydney.toLocal(utc());  // convert to local Sydney time (incl DST)
   return day(t);
 };
 
 // grab the hour from the UTC time and convert to Sydney time
 int WordClock::get_hour() {
-  time_t t = Sydney.toLocal(now());  // convert to local Sydney time (incl DST)
+  time_t t = Sydney.toLocal(utc());  // convert to local Sydney time (incl DST)
   return hour(t);
 };
 
 // grab the hour from the UTC time and convert to Sydney time
 // this is an inside joke, really, unless you're in Broken Hill
 int WordClock::get_minute() {
-  time_t t = Sydney.toLocal(now());  // convert to local Sydney time (incl DST)
+  time_t t = Sydney.toLocal(utc());  // convert to local Sydney time (incl DST)
   return minute(t);
 };
 
 // the loop - this runs every ~ 1.000 second
 void WordClock::loop() {
+#ifdef TIME_WARP
+  unsigned long loop_start = micros();
+#endif
+#ifdef SOAK
+  uint64_t loop_start_virtual = _time.uptime_ms();
+#endif
+#ifdef FLIGHT_RECORDER
+  uint64_t loop_start_ms = _time.uptime_ms();
+#endif
+
+#ifdef COOPERATIVE
+  // the tasks do the work (see _coopBegin()), whatever is due runs now
+  uint32_t idle = _coop.run(_time.uptime_ms());
+#else
+  // anything typed on the Serial port?
+  _serialCommand();
 
   // get current "hour" value from the clock
   int h = get_hour();
@@ -96,17 +180,108 @@ void WordClock::loop() {
   // show sun and moon info once an hour (at hh:00)
   // and update WiFi and NTP contacts every hour
   if (h != _last_hour) {
+#if !defined(TIME_WARP) || defined(SOAK)
     _ensure_wifi();
-    ntpClient.update();
+#ifdef LAN_SYNC
+    // followers take their time from the leader, no NTP traffic needed
+    if (!_sync.isFollowing()) {
+#endif
+      // runs in the background, the result is picked up below
+      _sntp.update();
+#ifdef LAN_SYNC
+    };
+#endif
+#ifdef OTA_UPDATE
+    // look for new firmware, downloads in the background on core 0
+    _ota.check();
+#endif
+#endif  // TIME_WARP
 
 #ifdef DEBUG
-    _show_sun_and_moon_info(now());
+    _show_sun_and_moon_info(utc());
 #endif
 
     // save the last hour for next round
     _last_hour = h;
   };
 
+#if !defined(TIME_WARP) || defined(SOAK)
+  // no time yet (no reply at boot): keep asking, update() ignores us while a round runs
+  if (!_time.isSet()) {
+    _sntp.update();
+  };
+  _ntpResult();
+#endif
+#ifdef FLIGHT_RECORDER
+  _logWiFi();
+#endif
+  _tick();
+  // pause until the next whole second, so the minute flips right on the boundary
+  // (and at the same instant on every clock that shares the time base)
+  uint32_t idle = _time.msToNextSecond();
+#endif  // COOPERATIVE
+
+#ifdef FLIGHT_RECORDER
+  // half way to a watchdog reset is worth remembering
+  uint32_t loop_ms = _time.uptime_ms() - loop_start_ms;
+  if (loop_ms > WDT_NEAR_MISS) {
+    _recorder.watchdog(loop_ms);
+  };
+#endif
+#ifdef TIME_WARP
+  _warp.tick(utc(), Sydney.toLocal(utc()), micros() - loop_start);
+#ifdef SOAK
+  // virtual ms this pass took, the watchdog would have seen that much
+  _soak.tick(_time.uptime_ms() - loop_start_virtual);
+#endif
+  if (_warp.finished()) {
+    _warp.report();
+#ifdef SOAK
+    _soak.report();
+#endif
+    // park here, the run is over
+    for (;;) {
+      delay(1000);
+      esp_task_wdt_reset();
+    };
+  };
+#endif
+  _sleep(idle);
+  // reset the watchdog
+  esp_task_wdt_reset();
+};
+
+// the once a second part of loop(): commands, the light, messages, the minute flip
+void WordClock::_tick() {
+#ifdef ALLOC_TRACK
+  // the network side may allocate (WiFi, UDP), this part must not
+  uint32_t allocs = AllocTracker::count();
+#endif
+
+#ifdef MQTT_STATE
+  // commands from the home automation
+  _mqttCommands();
+#endif
+
+#ifdef AMBIENT_LIGHT
+#ifdef TIME_WARP
+  // no sensor, a sample off the light trace per (virtual) second instead
+  _light.tick(Sydney.toLocal(utc()));
+#endif
+  // the room got visibly lighter or darker: repaint now, not on the next minute
+  // (a message keeps the face, its next page comes out at the new level)
+  if (_light.changed()) {
+    _last_minute = -1;
+  };
+#endif
+
+#ifdef MESSAGE
+  // a message owns the face (pages it, puts the clock back when its time is up)
+  if (_messageUntil != 0) {
+    _messageTick();
+  };
+#endif
+
   // get current "minute" value from the clock
   int m = get_minute();
   // print the clock if the minute has changed
@@ -119,25 +294,489 @@ void WordClock::loop() {
 
     // update and show the clock face display
     _showDisplay();
+#ifdef TIME_WARP
+    _warp.frame(_frame, utc());
+#endif
+#ifdef SOAK
+    _soak.flip();
+#endif
+#ifdef AMBIENT_LIGHT
+    if (_lightLog) {
+      _light.trace(Serial, Sydney.toLocal(utc()));
+    };
+#endif
+#ifdef FLIGHT_RECORDER
+    _recorder.frame(_frame);
+#endif
+#ifdef MQTT_STATE
+    _mqttPublish();
+#endif
+#ifdef OTA_UPDATE
+    // we got a whole minute on the face, so a freshly updated image is good
+    _ota.markValid();
+#endif
     // save the last minute for next round
     _last_minute = m;
   };
-  // pause 1 second
-  delay(1000);
-  // reset the watchdog
-  esp_task_wdt_reset();
+#ifdef ALLOC_TRACK
+  if (AllocTracker::count() != allocs) {
+    _steadyAllocs += AllocTracker::count() - allocs;
+#ifdef ECHO
+    Serial.print("Heap: ");
+    Serial.print(_steadyAllocs);
+    Serial.println(" allocation(s) in the steady state!");
+#endif
+  };
+#endif
 };
 
+#if !defined(TIME_WARP) || defined(SOAK)
+// the SNTP round has already applied its offset, we just log it
+void WordClock::_ntpResult() {
+  int32_t ntp_offset, ntp_delay;
+  int ntp_server;
+  if (_sntp.takeResult(ntp_offset, ntp_delay, ntp_server)) {
+#ifdef DEBUG
+    Serial.print("NTP: ");
+    Serial.print(ntpServers[ntp_server]);
+    Serial.print(" offset ");
+    Serial.print(ntp_offset);
+    Serial.print(" ms, delay ");
+    Serial.print(ntp_delay);
+    Serial.println(" ms");
+#endif
+#ifdef FLIGHT_RECORDER
+    _recorder.ntp(ntp_offset, ntp_delay);
+#endif
+    _syncOffset = ntp_offset;
+#ifdef SOAK
+    _soak.synced();
+#endif
+  };
+};
+#endif
+
+#ifdef FLIGHT_RECORDER
+// log WiFi coming and going
+void WordClock::_logWiFi() {
+  int w = WiFi.status();
+  if (w != _last_wifi) {
+    _recorder.wifi(w, WiFi.RSSI());
+    _last_wifi = w;
+  };
+};
+#endif
+
+#ifdef COOPERATIVE
+/*********************
+ * cooperative tasks *
+ *********************/
+
+// what loop() does with two cores, as tasks on one (see Coop.h)
+void WordClock::_coopBegin() {
+#if !defined(TIME_WARP) || defined(SOAK)
+  _coop.add("network", _coopNetwork, this);
+#endif
+  _coop.add("render", _coopRender, this);
+  _coop.add("log", _coopLog, this);
+  _effects = _coop.add("effects", _coopEffects, this);
+#if defined(LAN_SYNC) && !defined(TIME_WARP)
+  _coop.add("sync", _coopSync, this);
+#endif
+#if defined(AMBIENT_LIGHT) && !defined(TIME_WARP)
+  _coop.add("light", _coopLight, this);
+#endif
+#if defined(FACE_MIRROR) && !defined(TIME_WARP)
+  _coop.add("mirror", _coopMirror, this);
+#endif
+};
+
+#if !defined(TIME_WARP) || defined(SOAK)
+// WiFi and NTP once an hour; waits by giving the core back
+void WordClock::_coopNetwork(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    if (!self->_wifiConnected()) {
+#ifndef SOAK
+      WiFi.reconnect();
+#endif
+      // as _ensure_wifi(), but the face carries on meanwhile
+      COOP_WAIT_UNTIL(t, self->_wifiConnected() || COOP_WAITED(t) >= WIFI_WAIT, 500);
+    };
+#ifdef LAN_SYNC
+    // followers take their time from the leader, no NTP traffic needed
+    if (!self->_sync.isFollowing()) {
+#endif
+      self->_sntp.update();
+#ifdef LAN_SYNC
+    };
+#endif
+    COOP_WAIT_UNTIL(t, self->_sntp.poll(), COOP_NET_POLL);
+    self->_ntpResult();
+    // on the hour (our local hours are whole hours off UTC), every second without time
+    COOP_SLEEP(t, self->_time.isSet() ? 3600000 - self->_time.utc_ms() % 3600000 : 1000);
+  };
+  COOP_END(t);
+};
+#endif
+
+// the once a second part of loop(), on the second
+void WordClock::_coopRender(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    self->_serialCommand();
+    self->_tick();
+    COOP_SLEEP(t, self->_time.msToNextSecond());
+  };
+  COOP_END(t);
+};
+
+// WiFi changes into the flight recorder, and the hourly DEBUG info
+void WordClock::_coopLog(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+#ifdef FLIGHT_RECORDER
+    self->_logWiFi();
+#endif
+#ifdef DEBUG
+    if (self->get_hour() != self->_last_hour) {
+      self->_show_sun_and_moon_info(self->utc());
+      self->_coop.stats(Serial);
+      self->_last_hour = self->get_hour();
+    };
+#endif
+    COOP_SLEEP(t, COOP_LOG_PERIOD);
+  };
+  COOP_END(t);
+};
+
+#if defined(LAN_SYNC) && !defined(TIME_WARP)
+// ClockSync's task, as a look at the socket every SYNC_POLL ms
+void WordClock::_coopSync(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    self->_sync.poll();
+    COOP_SLEEP(t, SYNC_POLL);
+  };
+  COOP_END(t);
+};
+#endif
+
+#if defined(AMBIENT_LIGHT) && !defined(TIME_WARP)
+// AmbientLight's task, a reading every LIGHT_PERIOD ms
+void WordClock::_coopLight(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    self->_light.poll();
+    COOP_SLEEP(t, LIGHT_PERIOD);
+  };
+  COOP_END(t);
+};
+#endif
+
+#if defined(FACE_MIRROR) && !defined(TIME_WARP)
+// FaceMirror's task, a round of its sockets every MIRROR_TICK ms
+void WordClock::_coopMirror(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    self->_mirror.poll();
+    COOP_SLEEP(t, MIRROR_TICK);
+  };
+  COOP_END(t);
+};
+#endif
+
+// asleep until wake(), then the chase, a pixel per wakeup instead of delay()
+void WordClock::_coopEffects(CoopTask &t) {
+  WordClock *self = (WordClock *)t.self;
+  COOP_BEGIN(t);
+  for (;;) {
+    COOP_SUSPEND(t);
+    for (self->_chasePos = 0; self->_chasePos < NEO_PIXELS + 4; self->_chasePos++) {
+      self->_chaseStep(self->_chasePos, TESTCOLOR);
+      self->_last_minute = self->get_minute();  // keep the minute flip off the face meanwhile
+      COOP_SLEEP(t, COOP_CHASE_STEP);
+    };
+    self->_last_minute = -1;  // and the clock back
+  };
+  COOP_END(t);
+};
+#endif  // COOPERATIVE
+
+// single letter commands on the Serial port
+//   d       dump the flight recorder
+//   m text  spell text on the face for MESSAGE_TIME s, m alone puts the clock back
+//   b       time the message matching (DEBUG)
+//   p       next phrase mode (semi, five, exact)
+//   r       time the face renderer (DEBUG)
+//   w       what the face mirror sent so far
+//   s       how long the last frame took on the wire
+//   l       the light sensor: reading, filter, curve, level
+//   L       a "light HH:MM reading" line every minute, on/off (tools/light_trace.py)
+//   c       what the cooperative tasks cost (COOPERATIVE)
+//   k       time the cooperative scheduler (COOPERATIVE, DEBUG)
+void WordClock::_serialCommand() {
+  if (Serial.available() <= 0) {
+    return;
+  };
+  char c = Serial.read();
+  switch (c) {
+#ifdef FLIGHT_RECORDER
+    case 'd':
+      _recorder.dump(Serial);
+      break;
+#endif
+#ifdef MESSAGE
+    case 'm': {
+      // rest of the line, into our own buffer (no String)
+      size_t n = Serial.readBytesUntil('\n', _message, MESSAGE_MAX_LEN);
+      if (n > 0 && _message[n - 1] == '\r') {
+        n--;
+      };
+      _message[n] = '\0';
+      _messagePos = 0;
+      _messageNext = 0;
+      _messagePageEnd = 0;
+      _messageUntil = utc() + MESSAGE_TIME;
+      if (n == 0) {
+        _messageUntil = utc();  // ends on the next tick
+      };
+      _messageTick();
+      break;
+    };
+#ifdef DEBUG
+    case 'b':
+      Message::benchmark(Serial);
+      break;
+#endif
+#endif
+    case 'p':
+      _phrase = &phraseModes[(_phrase - phraseModes + 1) % PHRASE_MODES];
+#ifdef ECHO
+      Serial.print("Phrase mode: ");
+      Serial.println(_phrase->name);
+#endif
+      _last_minute = -1;
+      break;
+#ifdef DEBUG
+    case 'r':
+      FaceRenderer::benchmark(Serial, _faceDevice());
+      break;
+#endif
+#ifdef FACE_MIRROR
+    case 'w':
+      _mirror.stats(Serial);
+      break;
+#endif
+    case 's':
+      Serial.print("LED output: ");
+      Serial.print(NEO_SEGMENTS);
+      Serial.print(" segment(s), last frame ");
+#ifdef DITHER
+      Serial.print(_dither.showMicros());
+#else
+      Serial.print(_pixels.showMicros());
+#endif
+      Serial.println(" us on the wire");
+      break;
+#ifdef AMBIENT_LIGHT
+    case 'l':
+      _light.stats(Serial);
+      break;
+    case 'L':
+      _lightLog = !_lightLog;
+      break;
+#endif
+#ifdef COOPERATIVE
+    case 'c':
+      _coop.stats(Serial);
+      break;
+#ifdef DEBUG
+    case 'k':
+      CoopScheduler::benchmark(Serial);
+      break;
+#endif
+#endif
+    default:
+      break;
+  };
+};
+
+#ifdef MQTT_STATE
+// hand the state over, MQTTState only sends it if something changed
+void WordClock::_mqttPublish() {
+  MQTTState::Values v;
+  FaceRenderer::phrase(_face.words, v.phrase, sizeof(v.phrase));
+  v.level = _level;
+  v.brightness = _brightness;
+  v.offset_ms = _syncOffset;
+  v.rssi = WiFi.RSSI();
+  v.holiday = _holiday;
+  _mqtt.publish(v);
+};
+
+void WordClock::_mqttCommands() {
+  int b;
+  if (_mqtt.takeBrightness(b)) {
+    _brightness = b;
+    _last_minute = -1;  // repaint with it right away
+  };
+  char effect[MQTT_EFFECT_LEN];
+  if (!_mqtt.takeEffect(effect, sizeof(effect))) {
+    return;
+  };
+#ifdef ECHO
+  Serial.print("MQTT effect: ");
+  Serial.println(effect);
+#endif
+  if (strcmp(effect, "rainbow") == 0) {
+    _showRainbow();  // until the next minute flip
+  } else if (strcmp(effect, "chase") == 0) {
+#ifdef COOPERATIVE
+    _coop.wake(_effects);  // runs as its own task, the clock doesn't stop for it
+#else
+    _demoChase(TESTCOLOR);
+    _last_minute = -1;
+#endif
+#ifdef MESSAGE
+  } else if (strncmp(effect, "message ", 8) == 0) {
+    strncpy(_message, &effect[8], MESSAGE_MAX_LEN);
+    _message[MESSAGE_MAX_LEN] = '\0';
+    _messagePos = 0;
+    _messageNext = 0;
+    _messagePageEnd = 0;
+    _messageUntil = utc() + MESSAGE_TIME;
+    _messageTick();
+#endif
+  } else if (strncmp(effect, "phrase ", 7) == 0) {
+    const PhraseMode *mode = PhraseMode::byName(&effect[7]);
+    if (mode != NULL) {
+      _phrase = mode;
+      _last_minute = -1;
+    };
+  } else if (strcmp(effect, "clock") == 0) {
+#ifdef MESSAGE
+    _messageUntil = 0;
+#endif
+    _last_minute = -1;
+  };
+};
+#endif
+
+#ifdef MESSAGE
+// show the next page when it's due; when the message is done, the clock redraws
+void WordClock::_messageTick() {
+  time_t t = utc();
+  if (t >= _messageUntil) {
+    _messageUntil = 0;
+    _last_minute = -1;  // redraw the clock right away
+    return;
+  };
+  // keep the minute flip in loop() off the face meanwhile
+  _last_minute = get_minute();
+  if (t < _messagePageEnd) {
+    return;
+  };
+  if (_message[_messageNext] == '\0') {
+    _messageNext = 0;  // from the top
+  };
+  _messagePos = _messageNext;
+
+  FrameMask mask;
+#ifdef DEBUG
+  unsigned long start = micros();
+#endif
+  int used = Message::compose(&_message[_messagePos], mask);
+#ifdef DEBUG
+  unsigned long us = micros() - start;
+  Serial.print("Message: page at ");
+  Serial.print(_messagePos);
+  Serial.print(", ");
+  Serial.print(used);
+  Serial.print(" chars, ");
+  Serial.print(us);
+  Serial.println(" us");
+#endif
+  _messageNext = _messagePos + used;
+  // a one page message just stays up, more pages take turns
+  _messagePageEnd = (_messagePos == 0 && _message[_messageNext] == '\0') ? _messageUntil : t + MESSAGE_PAGE;
+
+  _clearDisplay();
+  _adjustBrightnessContrast();
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    if (mask.test(p)) {
+      _setPixel(p, MESSAGE_COLOR);
+    };
+  };
+  _show();
+#ifdef FLIGHT_RECORDER
+  _recorder.frame(_frame);
+#endif
+};
+#endif
+
+// sleep, or in time warp just move the virtual clock on
+void WordClock::_sleep(uint32_t ms) {
+#ifdef TIME_WARP
+  _time.advance(ms);
+#else
+  delay(ms);
+#endif
+};
+
+// push the pixels out to the strip (not in time warp, the frame mask is all we need)
+void WordClock::_show() {
+#if defined(DITHER)
+  _dither.commit(_pixels);  // the dither task does the actual sending
+#elif !defined(TIME_WARP)
+  _pixels.show();
+#ifdef DEBUG
+  Serial.print("NeoSegments: frame sent in ");
+  Serial.print(_pixels.showMicros());
+  Serial.println(" us");
+#endif
+#endif
+#ifdef FACE_MIRROR
+  // what the strip shows, in reading order, for the browsers
+  uint8_t rgb[NEO_PIXELS * 3];
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    uint32_t color = _pixels.getPixelColor(FACE(p / Face::COL_COUNT, p % Face::COL_COUNT));
+    rgb[3 * p] = color >> 16;
+    rgb[3 * p + 1] = color >> 8;
+    rgb[3 * p + 2] = color;
+  };
+  _mirror.publish(rgb);
+#endif
+};
+
+// "yyyy-mm-dd hh:mm:ss" into a caller's buffer - ctime() shares one static buffer
+// between everybody and may allocate it on first use
+static const char *_timeString(time_t t, char *buf) {
+  snprintf(buf, TIME_STRING_LEN, "%04d-%02d-%02d %02d:%02d:%02d",
+           year(t), month(t), day(t), hour(t), minute(t), second(t));
+  return buf;
+}
+
 void WordClock::_show_sun_and_moon_info(time_t t) {
+  _sunrise.calculate(LATITUDE, LONGITUDE, t);
+  _moonrise.calculate(LATITUDE, LONGITUDE, t);
+  _moonphase.calculate(t);
+  char buf[TIME_STRING_LEN];
   t = Sydney.toLocal(_sunrise.riseTime);
 #ifdef ECHO
   Serial.print("Sunrise: sun rises at: ");
-  Serial.println(ctime(&t));  // ctime(time_t *t) --> time_t t; ctime(&t)
+  Serial.println(_timeString(t, buf));
 #endif
   t = Sydney.toLocal(_sunrise.setTime);
 #ifdef ECHO
   Serial.print("Sunrise: sun sets at: ");
-  Serial.println(ctime(&t));
+  Serial.println(_timeString(t, buf));
   if (_sunrise.isVisible) {
     Serial.println("The sun is visible right now.");
   } else {
@@ -148,12 +787,12 @@ void WordClock::_show_sun_and_moon_info(time_t t) {
   t = Sydney.toLocal(_moonrise.riseTime);
 #ifdef ECHO
   Serial.print("Moonrise: moon rises at: ");
-  Serial.println(ctime(&t));
+  Serial.println(_timeString(t, buf));
 #endif
   t = Sydney.toLocal(_moonrise.setTime);
 #ifdef ECHO
   Serial.print("Moonrise: moon sets at: ");
-  Serial.println(ctime(&t));
+  Serial.println(_timeString(t, buf));
   if (_moonrise.isVisible) {
     Serial.println("The moon is visible right now.");
   } else {
@@ -183,10 +822,12 @@ void WordClock::_printDateTime() {
 #ifdef ECHO
   Serial.println("*******************************");
 #endif
-  time_t utc_time = now();
-  char *utc_str = ctime(&utc_time);
+  char utc_buf[TIME_STRING_LEN];
+  char local_buf[TIME_STRING_LEN];
+  time_t utc_time = utc();
+  const char *utc_str = _timeString(utc_time, utc_buf);
   time_t local = Sydney.toLocal(utc_time, &tcr);
-  char *local_str = ctime(&local);
+  const char *local_str = _timeString(local, local_buf);
 #ifdef ECHO
   Serial.print("utc:   ");
   Serial.println(utc_str);
@@ -201,18 +842,27 @@ void WordClock::_ensure_wifi() {
   Serial.println("Ensuring wifi is connected ...");
 #endif
 
-  if (WiFi.status() != WL_CONNECTED) {
+  if (!_wifiConnected()) {
+#ifndef SOAK
     WiFi.reconnect();
-    while (WiFi.status() != WL_CONNECTED) {
-      delay(500);
+#endif
+    // not for ever: the watchdog would reset us in the middle of an outage,
+    // the face carries on without WiFi and we try again next hour
+    uint64_t start = _time.uptime_ms();
+    while (!_wifiConnected() && _time.uptime_ms() - start < WIFI_WAIT) {
+      _sleep(500);
 #ifdef DEBUG
       Serial.print(".");
 #endif
     };
   };
 #ifdef DEBUG
-  Serial.print("WiFi.ssid is ");
-  Serial.println(WiFi.SSID());
+  // WiFi.SSID() builds a String on the heap, ask the driver directly
+  wifi_ap_record_t ap;
+  if (esp_wifi_sta_get_ap_info(&ap) == ESP_OK) {
+    Serial.print("WiFi.ssid is ");
+    Serial.println((const char *)ap.ssid);
+  };
   Serial.print("WiFi.channel # is ");
   Serial.println(WiFi.channel());
   Serial.print("WiFi.localIP is ");
@@ -226,17 +876,18 @@ void WordClock::_ensure_wifi() {
 #endif
 };
 
-void WordClock::_adjustBrightnessContrast() {
-  int hh = get_hour();
-  int mm = get_minute();
-  float _phase = 2 * PI * (hh * 60.0 + mm * 1.0) / (24.0 * 60.0);
-
-#ifdef DEBUG
-  Serial.print("Phase is ... ");
-  Serial.println(_phase);
+// the link as the clock sees it (in a soak test, as the fault script has it)
+bool WordClock::_wifiConnected() {
+#ifdef SOAK
+  return _soak.linkUp();
+#else
+  return WiFi.status() == WL_CONNECTED;
 #endif
+};
 
-  int _LEVEL = int(BRIGHTNESS - (CONTRAST * BRIGHTNESS / 255.0) * ((1 + cos(_phase)) / 2));
+void WordClock::_adjustBrightnessContrast() {
+  int _LEVEL = FaceRenderer::level(get_hour(), get_minute(), _faceDevice().config);
+  _level = _LEVEL;
 
 #ifdef DEBUG
   Serial.print("Brightness level is ");
@@ -247,23 +898,31 @@ void WordClock::_adjustBrightnessContrast() {
 #endif
 
   Black = Adafruit_NeoPixel::Color(0, 0, 0);
-  Dark = Adafruit_NeoPixel::Color(gamma8[uint8_t(2 * _LEVEL / 8)], gamma8[uint8_t(2 * _LEVEL / 8)], gamma8[uint8_t(2 * _LEVEL / 8)]);
-  Grey = Adafruit_NeoPixel::Color(gamma8[uint8_t(4 * _LEVEL / 8)], gamma8[uint8_t(4 * _LEVEL / 8)], gamma8[uint8_t(4 * _LEVEL / 8)]);
-  Silver = Adafruit_NeoPixel::Color(gamma8[uint8_t(5 * _LEVEL / 8)], gamma8[uint8_t(6 * _LEVEL / 8)], gamma8[uint8_t(6 * _LEVEL / 8)]);
-  White = Adafruit_NeoPixel::Color(gamma8[uint8_t(_LEVEL)], gamma8[uint8_t(_LEVEL)], gamma8[uint8_t(_LEVEL)]);
-
-  Red = Adafruit_NeoPixel::Color(gamma8[uint8_t(_LEVEL)], 0, 0);
-  Orange = Adafruit_NeoPixel::Color(gamma8[uint8_t(_LEVEL)], gamma8[uint8_t(_LEVEL / 2)], 0);
-  Yellow = Adafruit_NeoPixel::Color(gamma8[uint8_t(_LEVEL)], gamma8[uint8_t(_LEVEL)], 0);
-  Green = Adafruit_NeoPixel::Color(0, gamma8[uint8_t(_LEVEL)], 0);
-  Blue = Adafruit_NeoPixel::Color(0, 0, gamma8[uint8_t(_LEVEL)]);
-  Cyan = Adafruit_NeoPixel::Color(0, gamma8[uint8_t(_LEVEL)], gamma8[uint8_t(_LEVEL)]);
-  Magenta = Adafruit_NeoPixel::Color(gamma8[uint8_t(_LEVEL)], 0, gamma8[uint8_t(_LEVEL)]);
+  Dark = Adafruit_NeoPixel::Color(GAMMA(2 * _LEVEL / 8), GAMMA(2 * _LEVEL / 8), GAMMA(2 * _LEVEL / 8));
+  Grey = Adafruit_NeoPixel::Color(GAMMA(4 * _LEVEL / 8), GAMMA(4 * _LEVEL / 8), GAMMA(4 * _LEVEL / 8));
+  Silver = Adafruit_NeoPixel::Color(GAMMA(5 * _LEVEL / 8), GAMMA(6 * _LEVEL / 8), GAMMA(6 * _LEVEL / 8));
+  White = Adafruit_NeoPixel::Color(GAMMA(_LEVEL), GAMMA(_LEVEL), GAMMA(_LEVEL));
+
+  Red = Adafruit_NeoPixel::Color(GAMMA(_LEVEL), 0, 0);
+  Orange = Adafruit_NeoPixel::Color(GAMMA(_LEVEL), GAMMA(_LEVEL / 2), 0);
+  Yellow = Adafruit_NeoPixel::Color(GAMMA(_LEVEL), GAMMA(_LEVEL), 0);
+  Green = Adafruit_NeoPixel::Color(0, GAMMA(_LEVEL), 0);
+  Blue = Adafruit_NeoPixel::Color(0, 0, GAMMA(_LEVEL));
+  Cyan = Adafruit_NeoPixel::Color(0, GAMMA(_LEVEL), GAMMA(_LEVEL));
+  Magenta = Adafruit_NeoPixel::Color(GAMMA(_LEVEL), 0, GAMMA(_LEVEL));
 }
 
-// set a certain pixel to a certain Color
+// set a certain pixel to a certain Color, and keep track of what's lit
 void WordClock::_setPixel(int p, uint32_t Color) {
   _pixels.setPixelColor(p, Color);
+  if (p < 0 || p >= NEO_PIXELS) {
+    return;
+  };
+  if (Color == BACKGROUNDCOLOR) {
+    _frame.reset(p);
+  } else {
+    _frame.set(p);
+  };
 };
 
 // clear a certain pixel (set it to the BACKGROUNDCOLOR)
@@ -279,11 +938,11 @@ void WordClock::_clearDisplay() {
   for (int p = 0; p < _pixels.numPixels(); ++p) {
     _clearPixel(p);
   };
-  _pixels.show();
+  _show();
 };
 
 // show the (hour/minute) word on the clock face and on the serial port
-void WordClock::_setWord(int *Word, uint32_t Color) {
+void WordClock::_setWord(const int *Word, uint32_t Color) {
   for (int p = 0; p < _pixels.numPixels() + 1; p++) {
     if (Word[p] == -1) {
 #ifdef ECHO
@@ -293,192 +952,78 @@ void WordClock::_setWord(int *Word, uint32_t Color) {
     } else {
       _setPixel(Word[p], Color);
 #ifdef ECHO
-      Serial.print(wordClockString.at(Word[p]));
+      Serial.print(wordClockString[Word[p]]);
 #endif
     };
   };
 };
 
-// show the hour on the clock face and on the serial port
-void WordClock::_showHourSemiExact() {
-  // grab the stored minute (from local Sydney time from UTC, it's the same)
-  // grab the stored hour (from local Sydney time from UTC, use Timezone to shift)
-  int _minute = get_minute();
-  int _hour = get_hour();
-  if (_minute < 23) {
-    // show this hour if we are before 23 minutes past
-    // we start going weird at "7 minutes to half ten" (this is German, yeah?)
-    _setWord(wordHours[_hour % 12], FOREGROUNDCOLOR);
-  } else {
-    // show next hour
-    _setWord(wordHours[(_hour % 12) + 1], FOREGROUNDCOLOR);
-  }
-}
-
-// Show the minute on the clock face and on the serial port
-// We're using a semi-exact method here. it's a bit fuzzy.
-// Sometimes it shows the same time 2 mins in a row
-void WordClock::_showMinuteSemiExact() {
-  // grab the stored minute (from local Sydney time from UTC, it's the same)
-  int _minute = get_minute();
-  if (_minute != 0) {
-    for (int i = 0; i < 5; ++i) {
-      if (wordMinutes[_minute - 1][i] == wordNone) {
-        break;
-      } else {
-        _setWord(wordMinutes[_minute - 1][i], FOREGROUNDCOLOR);
-      }
-    }
-
-    if ((_minute > 0 && _minute < 23) || (_minute <= 37 && _minute > 30)) {
-      _setWord(wordPast, FOREGROUNDCOLOR);
-    }
-
-    if (_minute > 37 || (_minute >= 23 && _minute < 30)) {
-      _setWord(wordTo, FOREGROUNDCOLOR);
-    }
-
-    if (_minute >= 23 && _minute <= 37) {
-      _setWord(wordHalf, FOREGROUNDCOLOR);
-    }
-  }
-}
-
-// if it is x minutes PAST something, let's show "past/GSI"
-void WordClock::_showMinuteHasBeen() {
-  int _minute = get_minute();
-  if ((_minute > 15 && _minute < 18) || (_minute > 20 && _minute < 23) || (_minute > 35 && _minute < 38) || (_minute > 40 && _minute < 43) || (_minute > 45 && _minute < 48)) {
-    _setWord(wordBeen, FOREGROUNDCOLOR);
-  }
-}
-
-// on April 2nd (Raelene's birthday), we show a red love heart
-void WordClock::_showLoveHeart() {
-  time_t t = Sydney.toLocal(now());
-  int m = month(t);
-  int d = day(t);
-  if (m == 4 && d == 2) {  // 2/4/1974
-// special serial port output, too, every hour.
-#ifdef ECHO
-    Serial.println("Happy Birthday, Raelene Sheppard!");
+// this clock, for FaceRenderer
+FaceRenderer::Device WordClock::_faceDevice() {
+#ifdef AMBIENT_LIGHT
+  int ambient = _light.level();  // -1 until the sensor has a reading
+#else
+  int ambient = -1;
 #endif
-    _setWord(symbolLove, THECOLOROFLOVE);
-  };
-};
-
-// on Christmas Day show a Xmas Tree
-void WordClock::_showChristmas() {
-  // do something
-  time_t t = Sydney.toLocal(now());
-  int m = month(t);
-  int d = day(t);
-  if (m == 12 && (d == 25 || d == 26)) {  // 25.12., 26.12. -> Xmas
-    _setWord(symbolChristmas, CHRISTMASCOLOR);
-  };
-};
-
-// on Easter Sunday show a chicken
-void WordClock::_showEaster() {
-  time_t t = Sydney.toLocal(now());
-  int y = year(t);
-  int m = month(t);
-  int d = day(t);
-  // Gauss' algorithm
-  float A = y % 19;  // Metonic cycle
-  float B = y % 4;   // Leap years
-  float C = y % 7;   // 52 weeks test
-  float P = floor((float)y / 100.0);
-  float Q = floor((float)(13 + 8 * P) / 25.0);
-  float M = (int)(15 - Q + P - floor(P / 4)) % 30;  // M depends on the century of year Y. For 19th century, M = 23. For the 21st century, M = 24 and so on.
-  float N = (int)(4 + P - floor(P / 4)) % 7;        // difference between the number of leap days between the Julian and the Gregorian calendar
-  float D = (int)(19 * A + M) % 30;                 // number of days to be added to March 21 to find the date of the Paschal Full Moon
-  float E = (int)(N + 2 * B + 4 * C + 6 * D) % 7;   // number of days from the Paschal full moon to the next Sunday
-  int days = (int)(22 + D + E);
-  int e_m;
-  int e_d;
-  if (D == 29 && E == 6) {  // this is a an edge case
-    e_m = 4;
-    e_d = 19;
-  } else if (D == 28 && E == 6) {  // this is a an edge case
-    e_m = 4;
-    e_d = 18;
-  } else {
-    // If days > 31, move to April
-    if (days > 31) {
-      e_m = 4;
-      e_d = days - 31;
-    } else {
-      // Otherwise, stay on March
-      e_m = 3;
-      e_d = days;
-    }
-  }
-  // now make the chicken yellow if today is Easter Sunday
-  if (m == e_m && d == e_d) {
-    _setWord(symbolEaster, EASTERCOLOR);
-  };
-};
-
-// on Halloween (31/10/yyyy) show a ghost
-// it changes colour every minute, LOL
-void WordClock::_showHalloween() {
-  // do something
-  time_t t = Sydney.toLocal(now());
-  int m = month(t);
-  int d = day(t);
-  if (m == 10 && d == 31) {  // 31.10. -> Halloween
-    int mm = abs((minute(t) % 6) - 3);
-    switch (mm) {
-      case 0:
-        _setWord(symbolHalloween, HALLOWEEN_0);  // white
-        break;
-      case 1:
-        _setWord(symbolHalloween, HALLOWEEN_1);  // yellow
-        break;
-      case 2:
-        _setWord(symbolHalloween, HALLOWEEN_2);  // orange
-        break;
-      case 3:
-        _setWord(symbolHalloween, HALLOWEEN_3);  // red
-        break;
-    };
-  };
+  FaceRenderer::Device device = { &Sydney, LATITUDE, LONGITUDE,
+                                  { _phrase, _brightness, CONTRAST, BIRTHDAY_MONTH, BIRTHDAY_DAY, ambient } };
+  return device;
 };
 
 // show the clock face
 // IT IS (MINUTE|QUARTER) TO/PAST (HALF) (HOUR) HASBEEN
 // also show symbols
-// a
+// FaceRenderer works out what goes where, we hand it to the strip
 void WordClock::_showDisplay() {
-  // wipe the display
-  _clearDisplay();
-
-  // adjust contrast and brightness
+  // the global palette follows the day too, messages and tests paint with it
   _adjustBrightnessContrast();
 
-  // light up "it's" it stays on
-  _setWord(wordIt, FOREGROUNDCOLOR);
-  _setWord(wordIs, FOREGROUNDCOLOR);
-  // Light up minutes
-  _showMinuteSemiExact();
-  // light up hours
-  _showHourSemiExact();
-  // light up has been
-  _showMinuteHasBeen();
-  // light up symbols
-  // _showWiFiStatus();
-  // _showNTPStatus();
-  _showWarningStatus();
-  _showSunAndMoon();
-  // Warning symbols should go here, needs logic
-  _showLoveHeart();
-  _showEaster();
-  _showHalloween();
-  _showChristmas();
-  _pixels.show();
-// new line, please
+  // status symbols: what the face can't know from the time
+  uint8_t status = 0;
+  if (_wifiConnected()) {
+    status |= FaceRenderer::STATUS_WIFI;
+  };
+  if (_time.isSet()) {
+    status |= FaceRenderer::STATUS_TIME;
+  };
+#ifdef ALLOC_TRACK
+  if (_steadyAllocs > 0) {
+    // render/timekeeping path hit the heap, see AllocTracker.h
+    status |= FaceRenderer::STATUS_WARNING;
+  };
+#endif
+  FaceRenderer::render(utc(), _faceDevice(), status, _face);
+  for (int p = 0; p < NEO_PIXELS; p++) {
+    uint32_t c = _face.pixel[p];
+    _pixels.setPixelColor(p, GAMMA(c >> 16), GAMMA(c >> 8), GAMMA(c));
+  };
+  _frame = _face.lit;
+  _level = _face.level;
+  _holiday = _face.holiday;
 #ifdef ECHO
-  Serial.println();
+  char text[FACE_PHRASE_LEN];
+  FaceRenderer::phrase(_face.words, text, sizeof(text));
+  Serial.println(text);
+  if (strcmp(_holiday, "birthday") == 0) {
+    Serial.println("Happy Birthday, Raelene Sheppard!");
+  };
+#endif
+  _show();
+#if defined(DITHER) && defined(DEBUG)
+  // measured refresh rate, how much of core 1 the dithering arithmetic takes, and how
+  // much of the time the strip is being sent (the RMT interrupt runs all through that)
+  float rate = _dither.refreshRate();
+  Serial.print("Dither: ");
+  Serial.print(rate);
+  Serial.print(" Hz, compute ");
+  Serial.print(_dither.computeMicros());
+  Serial.print(" us, show ");
+  Serial.print(_dither.showMicros());
+  Serial.print(" us, CPU ");
+  Serial.print(100.0 * _dither.computeMicros() * rate / 1000000.0);
+  Serial.print("%, on the wire ");
+  Serial.print(100.0 * _dither.showMicros() * rate / 1000000.0);
+  Serial.println("%");
 #endif
 };
 
@@ -490,9 +1035,7 @@ void WordClock::_demoChase(uint32_t Color) {
   Serial.print(")... ");
 #endif
   for (uint16_t p = 0; p < _pixels.numPixels() + 4; p++) {
-    _setPixel(p, Color);                // Draw new pixel
-    _setPixel(p - 4, BACKGROUNDCOLOR);  // Erase pixel a few steps back
-    _pixels.show();
+    _chaseStep(p, Color);
     delay(10);
   };
 #ifdef ECHO
@@ -500,6 +1043,13 @@ void WordClock::_demoChase(uint32_t Color) {
 #endif
 };
 
+// one step of the chase: a new pixel, and the one a few steps back off again
+void WordClock::_chaseStep(int p, uint32_t Color) {
+  _setPixel(p, Color);                // Draw new pixel
+  _setPixel(p - 4, BACKGROUNDCOLOR);  // Erase pixel a few steps back
+  _show();
+};
+
 void WordClock::_showRainbow() {
   _clearDisplay();
   for (uint8_t p = 0; p < _pixels.numPixels(); p++) {
@@ -509,68 +1059,7 @@ void WordClock::_showRainbow() {
     uint32_t colour = _pixels.ColorHSV(hue, saturation, value);
     _setPixel(p, colour);
   };
-  _pixels.show();
-};
-
-// include WiFi.reconnect()
-void WordClock::_showWiFiStatus() {
-  if (WiFi.status() == WL_CONNECTED) {
-    _setWord(symbolWiFi, WIFICONNECTED);
-  } else {
-    _setWord(symbolWiFi, WIFIDISCONNECTED);
-  }
-};
-
-void WordClock::_showNTPStatus() {
-  if (ntpClient.isTimeSet()) {
-    _setWord(symbolTime, NTP_SET);
-  } else {
-    _setWord(symbolTime, NTP_NOT_SET);
-  };
-};
-
-void WordClock::_showWarningStatus() {
-  int warning = 0x0;
-  if (WiFi.status() != WL_CONNECTED) {
-    // fail!
-    _setWord(symbolWiFi, WIFIDISCONNECTED);
-    warning = warning || 0x01;
-  } else {
-    // success!
-    _setWord(symbolWiFi, WIFICONNECTED);
-  };
-
-  if (ntpClient.isTimeSet()) {
-    // success!
-    _setWord(symbolTime, NTP_SET);
-  } else {
-    // fail!
-    _setWord(symbolTime, NTP_NOT_SET);
-    warning = warning || 0x02;
-  };
-
-  if (warning > 0) {
-    _setWord(symbolWarning, WARNING_COLOR);
-  } else {
-    _setWord(symbolWarning, BACKGROUNDCOLOR);
-  };
-  // _showDisplay() will be called in loop() right after this
-};
-
-void WordClock::_showSunAndMoon() {
-  time_t t = now();
-  _sunrise.calculate(LATITUDE, LONGITUDE, t);
-  if (_sunrise.isVisible) {
-    _setWord(symbolSun, SUN_COLOR);
-  } else {
-    _setWord(symbolSun, BACKGROUNDCOLOR);
-  };
-  _moonrise.calculate(LATITUDE, LONGITUDE, t);
-  if (_moonrise.isVisible) {
-    _setWord(symbolMoon, MOON_COLOR);
-  } else {
-    _setWord(symbolMoon, BACKGROUNDCOLOR);
-  };
+  _show();
 };
 
 void WordClock::_showMinutesAndHours() {
@@ -583,17 +1072,11 @@ void WordClock::_showMinutesAndHours() {
   _setWord(wordBeen, TESTCOLOR);
 
 #ifdef DEBUG
-  Serial.println("Listing wordMinutes ... ");
-#endif
-  for (int _minute = 1; _minute < 59; _minute++) {
-    for (int i = 0; i < 5; ++i) {
-      if (wordMinutes[_minute - 1][i] == wordNone) {
-        break;
-      } else {
-        _setWord(wordMinutes[_minute - 1][i], TESTCOLOR);
-      }
-    }
-  }
+  Serial.println("Listing phraseWords ... ");
+#endif
+  for (int w = PW_NONE + 1; w < PW_COUNT; w++) {
+    _setWord(phraseWords[w], TESTCOLOR);
+  };
 #ifdef DEBUG
   Serial.println();
 #endif
@@ -9,6 +9,47 @@
 #define ECHO
 #undef DEBUG
 #undef TEST_CLOCK
+#undef OTA_UPDATE               // needs OTA_PUBLIC_KEY in utils.h, see OTAUpdate.h
+#undef LAN_SYNC
+#undef TIME_WARP
+#undef SOAK
+#undef DITHER                   // deep-night brightness, see Dither.h for what it costs
+#define ALLOC_TRACK
+#define FLIGHT_RECORDER
+#define MESSAGE
+#define MQTT_STATE
+#define FACE_MIRROR
+#undef AMBIENT_LIGHT
+#undef COOPERATIVE              // one core (ESP32-C3, -S2): loop() runs cooperative tasks
+
+// the soak test is time warp with a fake network that fails on cue
+#ifdef SOAK
+#define TIME_WARP
+#endif
+
+// time warp runs years of loop() in minutes and owns the Serial port for its trace
+#ifdef TIME_WARP
+#undef ECHO
+#undef DEBUG
+#undef TEST_CLOCK
+#undef OTA_UPDATE
+#undef LAN_SYNC
+#undef DITHER
+#undef FLIGHT_RECORDER
+#undef MESSAGE
+#undef MQTT_STATE
+#undef FACE_MIRROR
+#endif
+
+// one core: nothing gets a FreeRTOS task (and a stack) of its own. LAN sync, the light
+// sensor and the face mirror poll from cooperative tasks instead (see _coopBegin());
+// the dither refresh wants a core to itself at 200 Hz, and OTA and MQTT block in
+// libraries that bring their own tasks, so those are off
+#ifdef COOPERATIVE
+#undef DITHER
+#undef OTA_UPDATE
+#undef MQTT_STATE
+#endif
 
 #include <Arduino.h>
 #include <Math.h>               // for pow() conversion of RSSI signal strength (can discard later)
@@ -16,12 +57,18 @@
 #include <WiFiUDP.h>            // https://www.arduino.cc/reference/en/libraries/wifi/wifiudp/
 #include <Timezone.h>           // https://github.com/JChristensen/Timezone
 #include <TimeLib.h>            // https://github.com/PaulStoffregen/Time
-#include <NTPClient.h>          // https://github.com/arduino-libraries/NTPClient
 #include <SunRise.h>            // https://github.com/signetica/SunRise
 #include <MoonRise.h>           // https://github.com/signetica/MoonRise
 #include <MoonPhase.h>          // https://github.com/signetica/MoonPhase
 #include <Adafruit_NeoPixel.h>  // https://github.com/adafruit/Adafruit_NeoPixel
 #include "utils.h"              // local wifi ssid/pwd etc
+#include "OTAUpdate.h"          // over-the-air firmware updates
+#include "TimeBase.h"           // millisecond UTC clock
+#include "SNTPClient.h"         // sub-second, multi-server NTP
+#include "ClockSync.h"          // optional LAN sync between several clocks
+#include "FaceLayout.h"         // the grid, its letters, words and symbols
+#include "AllocTracker.h"       // counts heap allocations in the steady state
+#include <esp_wifi.h>           // esp_wifi_sta_get_ap_info(), allocation free SSID
 #include <esp_task_wdt.h>       // https://docs.espressif.com/projects/esp-idf/en/latest/esp32/api-reference/system/wdts.html
                                 // https://iotassistant.io/esp32/enable-hardware-watchdog-timer-esp32-arduino-ide/
 
@@ -45,7 +92,6 @@
    WiFi@2.0.0
    Timezone@1.2.4
    Time@1.6.1
-   NTPClient@3.2.1
    SunRise@2.0.4
    MoonRise@2.0.4
    MoonPhasePlus@2.0.1 (not actually used)
@@ -60,23 +106,71 @@
    for local variables. Maximum is 327680 bytes.
  */
 
+// bump this for every release, OTA compares it against the manifest on the server
+#define FIRMWARE_VERSION "2024.10.23"
+
 //30 seconds Watchdog timer
 #define WDT_TIMEOUT 30
+#define WDT_NEAR_MISS (WDT_TIMEOUT * 1000 / 2)  // ms, a loop() this slow goes into the flight recorder
 
 // Australia/Sydney
-#define NTP_POOL "AU.POOL.NTP.ORG"
-#define NTP_OFFSET 0            // we'll do timezones separately, including DST as well
-#define NTP_INTERVAL 60000      // refresh every minute
+// all of them are asked, the one with the shortest round trip wins (max SNTP_MAX_SERVERS)
+#define NTP_SERVERS "0.au.pool.ntp.org", "1.au.pool.ntp.org", "2.au.pool.ntp.org", "3.au.pool.ntp.org"
+#define NTP_PORT 123
+#define NTP_WAIT 10000          // ms to wait for the first time at boot
+#define WIFI_WAIT 10000         // ms _ensure_wifi() waits for the link, well inside WDT_TIMEOUT
 #define LATITUDE -33.7          //  lat
 #define LONGITUDE 151.1         //  long
+#define BIRTHDAY_MONTH 4        // red love heart on 2/4 (Raelene's birthday)
+#define BIRTHDAY_DAY 2
 
-#define NEO_PIXELS 144          // 12x12=144 LEDs
 #define NEO_PIN 27              // neopixel data pin
+// one data pin for the whole face; a bigger face can be split over several pins that
+// are sent in parallel, see NeoSegments.h: { pin, first pixel, count, reversed }
+#define NEO_SEGMENTS 1
+#define NEO_SEGMENT_MAP { NEO_PIN, 0, NEO_PIXELS, false }
+// e.g. two halves, the second fed from the far end
+// #define NEO_SEGMENTS 2
+// #define NEO_SEGMENT_MAP { 27, 0, 72, false }, { 26, 72, 72, true }
+// or four, three rows each
+// #define NEO_SEGMENTS 4
+// #define NEO_SEGMENT_MAP { 27, 0, 36, false }, { 26, 36, 36, false }, { 25, 72, 36, false }, { 33, 108, 36, false }
 #define BRIGHTNESS 196          // max intensity 0..255 -> peak LED intensity
 #define CONTRAST 128            // max contrast  0..255 -> relative reduction in LED intensity, see (*) below
 // (*) _LEVEL = int(BRIGHTNESS - (CONTRAST*BRIGHTNESS/255.0)*((1-cos(_phase))/2));
+// with AMBIENT_LIGHT a sensor sets the level instead: reading -> share of BRIGHTNESS (0..255),
+// straight lines between the points (see AmbientLight.h)
+#define LIGHT_SENSOR LIGHT_LDR  // LDR from 3.3V, 10k to GND, the middle on an ADC1 pin
+#define LIGHT_PIN 34
+#define LIGHT_CURVE { 0, 16 }, { 100, 40 }, { 600, 128 }, { 2000, 255 }  // ADC counts
+// or a BH1750 lux sensor on I2C
+// #define LIGHT_SENSOR LIGHT_BH1750
+// #define LIGHT_SDA 21
+// #define LIGHT_SCL 22
+// #define LIGHT_CURVE { 0, 16 }, { 10, 40 }, { 150, 128 }, { 1000, 255 }  // lux
 
+#define TIME_STRING_LEN 20      // "yyyy-mm-dd hh:mm:ss" + '\0'
 #define TEST_DELAY_TIME 1000    // just in case we want to test the display with chase, all words, etc.
+#define MESSAGE_TIME 60         // s a message stays up, then the clock comes back
+#define MESSAGE_PAGE 3          // s per page, when a message needs more than one face
+#define PHRASE_DEFAULT PHRASE_SEMI_EXACT  // or PHRASE_FIVE_MINUTE, PHRASE_EXACT (see PhraseMode.h)
+
+// these size themselves from NEO_PIXELS
+#include "FrameMask.h"          // lit/unlit map of the face, one bit per LED
+#include "TimeWarp.h"           // accelerated simulation of loop()
+#include "NeoSegments.h"        // parallel output over several data pins
+#include "Dither.h"             // temporal dithering for the dim end of the range
+#include "FlightRecorder.h"     // event log that survives reboots
+#include "Message.h"            // free text spelled on the face
+#include "MQTTState.h"          // state for the home automation
+#include "PhraseMode.h"         // minute -> words tables, one per way of telling the time
+#include "FaceRenderer.h"       // what the face shows, without the hardware
+#include "FaceMirror.h"         // the live face in a browser
+#include "Soak.h"               // time warp with network and time faults
+#include "AmbientLight.h"       // brightness from a light sensor
+#include "Coop.h"               // cooperative tasks for single core parts
+
+static const char *const ntpServers[] = { NTP_SERVERS };
 
 class WordClock {
 public:
@@ -93,34 +187,105 @@ private:
   int _last_minute;
   int _last_hour;
   int _last_day;
-  int _brightness = BRIGHTNESS;
+  int _brightness = BRIGHTNESS;  // peak of the day/night curve (MQTT can change it)
+  int _level = BRIGHTNESS;       // where the curve is right now
+  const char *_holiday = "none"; // symbol on the face, for MQTT
+  int32_t _syncOffset = 0;       // last NTP correction, ms
   int _contrast = CONTRAST;
+  const PhraseMode *_phrase = &phraseModes[PHRASE_DEFAULT];
+  TimeBase _time;
+#if !defined(TIME_WARP) || defined(SOAK)
+  SNTPClient _sntp{ _time, ntpServers, sizeof(ntpServers) / sizeof(ntpServers[0]), NTP_PORT };
+#endif
+#ifdef LAN_SYNC
+  ClockSync _sync;
+#endif
+  FrameMask _frame;   // what's lit right now
+  FaceRenderer::Frame _face;  // the last face rendered
+#ifdef FLIGHT_RECORDER
+  FlightRecorder _recorder;
+  int _last_wifi = -1;
+#endif
+#ifdef ALLOC_TRACK
+  uint32_t _steadyAllocs = 0;  // heap allocations seen in loop() after begin()
+#endif
+#ifdef DITHER
+  Dither _dither{ NEO_PIXELS, NEO_PIN };  // drives the strip, _pixels only holds the frame
+#endif
+#ifdef TIME_WARP
+  TimeWarp _warp;
+#endif
+#ifdef SOAK
+  Soak _soak;
+#endif
+#ifdef MQTT_STATE
+  MQTTState _mqtt;
+#endif
+#ifdef FACE_MIRROR
+  FaceMirror _mirror;
+#endif
+#ifdef AMBIENT_LIGHT
+  AmbientLight _light;
+  bool _lightLog = false;      // Serial 'L': a trace line every minute
+#endif
+#ifdef COOPERATIVE
+  CoopScheduler _coop;
+  CoopTask *_effects = NULL;
+  int _chasePos = 0;           // the effects task's, it has no stack to keep it on
+#endif
+#ifdef MESSAGE
+  char _message[MESSAGE_MAX_LEN + 1] = "";
+  int _messagePos = 0;         // start of the page on the face
+  int _messageNext = 0;        // and of the next one
+  time_t _messageUntil = 0;    // 0: no message, the clock is showing
+  time_t _messagePageEnd = 0;
+#endif
   SunRise _sunrise;
   MoonRise _moonrise;
   MoonPhase _moonphase;
-  Adafruit_NeoPixel _pixels = Adafruit_NeoPixel(NEO_PIXELS, NEO_PIN, NEO_GRB + NEO_KHZ800);
+  NeoStrip _pixels = NeoStrip(NEO_PIXELS, NEO_PIN, NEO_GRB + NEO_KHZ800);
+#ifdef OTA_UPDATE
+  OTAUpdate _ota;
+#endif
   // private methods
   void _show_sun_and_moon_info(time_t t);
   void _printDateTime();
+  void _tick();
+  void _ntpResult();
+  void _logWiFi();
   void _ensure_wifi();
+  bool _wifiConnected();
   void _adjustBrightnessContrast();
   void _clearPixel(int p);
   void _setPixel(int p, uint32_t Color);
   void _clearDisplay();
-  void _setWord(int *Word, uint32_t Color);
-  void _showHourSemiExact();
-  void _showMinuteSemiExact();
-  void _showMinuteHasBeen();
-  void _showWiFiStatus();
-  void _showNTPStatus();
-  void _showWarningStatus();
-  void _showSunAndMoon();
-  void _showLoveHeart();
-  void _showEaster();
-  void _showChristmas();
-  void _showHalloween();
+  void _show();
+  void _sleep(uint32_t ms);
+  void _setWord(const int *Word, uint32_t Color);
+  FaceRenderer::Device _faceDevice();
   void _showDisplay();
+  void _serialCommand();
+  void _messageTick();
+  void _mqttPublish();
+  void _mqttCommands();
   void _demoChase(uint32_t Color);
+  void _chaseStep(int p, uint32_t Color);
+#ifdef COOPERATIVE
+  void _coopBegin();
+  static void _coopNetwork(CoopTask &t);
+  static void _coopRender(CoopTask &t);
+  static void _coopLog(CoopTask &t);
+  static void _coopEffects(CoopTask &t);
+#if defined(LAN_SYNC) && !defined(TIME_WARP)
+  static void _coopSync(CoopTask &t);
+#endif
+#if defined(AMBIENT_LIGHT) && !defined(TIME_WARP)
+  static void _coopLight(CoopTask &t);
+#endif
+#if defined(FACE_MIRROR) && !defined(TIME_WARP)
+  static void _coopMirror(CoopTask &t);
+#endif
+#endif
   void _showMinutesAndHours();
   void _showRainbow();
   void _test_Word_Clock();
@@ -129,230 +294,28 @@ protected:
   // we don't have any protected stuff to pass on to children/derived classes
 };
 
-// 144 char string which mimics the clock face, in a meander pattern - used to spit out the time on the Serial interface
-const std::string wordClockString = "aSZISCH!*)w@LETREIVJDLABZWEISFuFACHTFLoWZXFLEuRDSaCHSIEBaZaHKGIZNAWZaNuNVORAB&VHALBIITHCABIFLoWZDRuFuFIZaHNIYIREIVWSIEWZSaCHSIEBNIGQISGPINuNIFLE";
-// const String "ÄSZISCH#####LETREIVJDLABZWEISFÜFACHTFLÖWZXFLEÜRDSÄCHSIEBÄZÄHKGIZNAWZÄNÜNVORAB#VHALBIITHCABIFLÖWZDRÜFÜFIZÄHNIYIREIVWSIEWZSÄCHSIEBNIGQISGPINÜNIFLE";
-
-// gamma correction LUT
-static uint8_t gamma8[] = {
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
-    0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
-    1,  1,  1,  1,  1,  1,  1,  1,  1,  2,  2,  2,  2,  2,  2,  2,
-    2,  3,  3,  3,  3,  3,  3,  3,  4,  4,  4,  4,  4,  5,  5,  5,
-    5,  6,  6,  6,  6,  7,  7,  7,  7,  8,  8,  8,  9,  9,  9, 10,
-   10, 10, 11, 11, 11, 12, 12, 13, 13, 13, 14, 14, 15, 15, 16, 16,
-   17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22, 23, 24, 24, 25,
-   25, 26, 27, 27, 28, 29, 29, 30, 31, 32, 32, 33, 34, 35, 35, 36,
-   37, 38, 39, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 50,
-   51, 52, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 66, 67, 68,
-   69, 70, 72, 73, 74, 75, 77, 78, 79, 81, 82, 83, 85, 86, 87, 89,
-   90, 92, 93, 95, 96, 98, 99,101,102,104,105,107,109,110,112,114,
-  115,117,119,120,122,124,126,127,129,131,133,135,137,138,140,142,
-  144,146,148,150,152,154,156,158,160,162,164,167,169,171,173,175,
-  177,180,182,184,186,189,191,193,196,198,200,203,205,208,210,213,
-  215,218,220,223,225,228,231,233,236,239,241,244,247,249,252,255  
-};
+// with DITHER the palette holds gamma input levels, Dither applies its 16 bit gamma16[] itself
+#ifdef DITHER
+#define GAMMA(level) uint8_t(level)
+#else
+#define GAMMA(level) gamma8[uint8_t(level)]
+#endif
 
 // Neopixel colours - sorry, it's a USA library so it uses Color for colours ... doh!
 // we're gonna do this a little different
 // declared static as they're defined outside the WordClock class but used inside the WordClock class
 static unsigned long Black =  Adafruit_NeoPixel::Color(0, 0, 0);
-static unsigned long Dark =   Adafruit_NeoPixel::Color(gamma8[uint8_t(1*BRIGHTNESS/8)], gamma8[uint8_t(1*BRIGHTNESS/8)], gamma8[uint8_t(1*BRIGHTNESS/8)]);
-static unsigned long Grey =   Adafruit_NeoPixel::Color(gamma8[uint8_t(4*BRIGHTNESS/8)], gamma8[uint8_t(4*BRIGHTNESS/8)], gamma8[uint8_t(4*BRIGHTNESS/8)]);
-static unsigned long Silver = Adafruit_NeoPixel::Color(gamma8[uint8_t(6*BRIGHTNESS/8)], gamma8[uint8_t(6*BRIGHTNESS/8)], gamma8[uint8_t(6*BRIGHTNESS/8)]);
-static unsigned long White =  Adafruit_NeoPixel::Color(gamma8[uint8_t(BRIGHTNESS)], gamma8[uint8_t(BRIGHTNESS)], gamma8[uint8_t(BRIGHTNESS)]);
-
-static unsigned long Red =    Adafruit_NeoPixel::Color(gamma8[uint8_t(BRIGHTNESS)], 0, 0);
-static unsigned long Orange = Adafruit_NeoPixel::Color(gamma8[uint8_t(BRIGHTNESS)], gamma8[uint8_t(BRIGHTNESS/2)], 0);
-static unsigned long Yellow = Adafruit_NeoPixel::Color(gamma8[uint8_t(BRIGHTNESS)], gamma8[uint8_t(BRIGHTNESS)], 0);
-static unsigned long Green =  Adafruit_NeoPixel::Color(0, gamma8[uint8_t(BRIGHTNESS)], 0);
-static unsigned long Blue =   Adafruit_NeoPixel::Color(0, 0, gamma8[uint8_t(BRIGHTNESS)]);
-static unsigned long Cyan =   Adafruit_NeoPixel::Color(0, gamma8[uint8_t(BRIGHTNESS)], gamma8[uint8_t(BRIGHTNESS)]);
-static unsigned long Magenta = Adafruit_NeoPixel::Color(gamma8[uint8_t(BRIGHTNESS)], 0, gamma8[uint8_t(BRIGHTNESS)]);
-
-// Colour shortcuts for symbols
-// note - these are pre-processor macros
-// actual code will be compiles with Silver, Black, Orange, etc.
-// Colours Black, Dark. Grey, Silver, White, Red, Green Blue etc will be adjusted for contrast and brightness
-// during the diurnal cycle - bright at lunchtime, dark at midnight
-#define FOREGROUNDCOLOR  White
-#define BACKGROUNDCOLOR  Dark
-#define TESTCOLOR        Orange
-#define WIFIDISCONNECTED Red
-#define WIFICONNECTING   Orange
-#define WIFICONNECTED    Blue
-#define NTP_NOT_SET      Blue
-#define NTP_SET          Green
-#define THECOLOROFLOVE   Red
-#define CHRISTMASCOLOR   Green
-#define EASTERCOLOR      Yellow
-#define HALLOWEEN_0      White
-#define HALLOWEEN_1      Yellow
-#define HALLOWEEN_2      Orange
-#define HALLOWEEN_3      Red
-#define SUN_COLOR        Yellow
-#define MOON_COLOR       Cyan
-#define WARNING_COLOR    Orange
-
-// Various symbols on the clock face
-// each special symbol is mapped to an LED in the string
-// note that the string zigzags back and forth over the clock
-static int symbolWiFi[] = { 11, -1 };     // show [@]  when WiFi connected (blue=connecting, green=OK, red=disconnected)
-static int symbolTime[] = { 10, -1 };     // show [#]  when ntp is synced 
-static int symbolMoon[] = { 9, -1 };      // show [o]  at night (if !(sunrise.isVisible) ) [O]
-static int symbolSun[] = { 8, -1 };       // show [*]  during daytime (if sunrise.isVisible)
-static int symbolLove[] = { 77, -1 };     // show [<3] on dd/mm/yyyy only
-static int symbolChristmas[] = { 41, -1 };// show [Xmas tree] on 25/12/yyyy only
-static int symbolEaster[] = { 114, -1 };  // show [chicken] on Easter Sunday only
-static int symbolHalloween[] = {60, -1};  // show [Ghost] on Halloween (31/10/yyyy) only
-static int symbolWarning[] = { 7, -1 };   // show [!]  some sort of error display (not used yet)
-
-// Various useful (?) words on the clock face
-// static int arrayname = { series, of, LEDs, finished, with, a, -1}
-static int wordNone[] = { -1 };
-static int wordIt[] = { 0, 1, -1 };
-static int wordIs[] = { 3, 4, 5, 6, -1 };
-static int wordSoon[] = { 23, 22, 21, 20, -1 };
-static int wordQuarter[] = { 18, 17, 16, 15, 14, 13, 12, -1 };
-static int wordHalf[] = { 79, 80, 81, 82, 83, -1 };
-static int wordTo[] = { 72, 73, 74, -1 };
-static int wordPast[] = { 75, 76, -1 };
-static int wordBeen[] = { 134, 133, 132, -1 };
-
-// all the 29 minute words (past, to), including some compounds
-static int wordMinuteOne[] = { 26, 27, 28, -1 };
-static int wordMinuteTwo[] = { 24, 25, 26, 27, -1 };
-static int wordMinuteThree[] = { 47, 46, 45, -1 };
-static int wordMinuteFour[] = { 18, 17, 16, 15, -1 };
-static int wordMinuteFive[] = { 29, 30, 31, -1 };
-static int wordMinuteSix[] = { 48, 49, 50, 51, 52, -1 };
-static int wordMinuteSeven[] = { 52, 53, 54, 55, 56, -1 };
-static int wordMinuteEight[] = { 32, 33, 34, 35, -1 };
-static int wordMinuteNine[] = { 71, 70, 69, -1 };
-static int wordMinuteTen[] = { 57, 58, 59, -1 };
-static int wordMinuteEleven[] = { 44, 43, 42, -1 };
-static int wordMinuteTwelve[] = { 40, 39, 38, 37, 36, -1 };
-static int wordMinuteTwenty[] = { 67, 66, 65, 64, 63, 62, 61, -1 };
-static int wordMinuteTwentyOne[] = { 26, 27, 69, 68, 67, 66, 65, 64, 63, 62, 61, -1 };                // for EINaZWANZIG
-static int wordMinuteTwentyTwo[] = { 24, 25, 26, 27, 68, 67, 66, 65, 64, 63, 62, 61, -1 };            // for ZweiaZWANZIG
-static int wordMinuteTwentyThree[] = { 47, 46, 45, 68, 67, 66, 65, 64, 63, 62, 61, -1 };              // for DruaZWANZIG
-static int wordMinuteTwentyFour[] = { 18, 17, 16, 15, 68, 67, 66, 65, 64, 63, 62, 61, -1 };           // for VIERaZWANZIG
-static int wordMinuteTwentyFive[] = { 29, 30, 31, 68, 67, 66, 65, 64, 63, 62, 61, -1 };               // for FuFaZWANZIG
-static int wordMinuteTwentySix[] = { 48, 49, 50, 51, 52, 68, 67, 66, 65, 64, 63, 62, 61, -1 };        // for SaCHSaZWANZIG
-static int wordMinuteTwentySeven[] = { 52, 53, 54, 55, 56, 69, 68, 67, 66, 65, 64, 63, 62, 61, -1 };  // for SIEBaNaZWANZIG
-static int wordMinuteTwentyEight[] = { 32, 33, 34, 35, 68, 67, 66, 65, 64, 63, 62, 61, -1 };          // for ACHTaZWANZIG
-static int wordMinuteTwentyNine[] = { 71, 70, 69, 68, 67, 66, 65, 64, 63, 62, 61, -1 };               // for NuNaZWANZIG
-
-/* some notes on how we count just past the hour, approaching the half hour, etc.
-* m=0 (don't write minutes, just write hour)
-* 0 < m < 5  -> write Minute
-* (0 < m < 23) || (30 < m < 38)  -> write Past
-* (37 < m ) || (22 < m < 30) -> write To
-* 22 < m < 38  -> write Half
-*/
-
-// assembly of the 59 minutes words using soon, quarter, half, etc.
-static int* wordMinutes[][59] = {
-  { wordMinuteOne, wordNone },                  //  1
-  { wordMinuteTwo, wordNone },                  //  2
-  { wordMinuteThree, wordNone },                //  3
-  { wordMinuteFour, wordNone },                 //  4
-  { wordMinuteFive, wordNone },                 //  5
-  { wordMinuteSix, wordNone },                  //  6
-  { wordMinuteSeven, wordNone },                //  7
-  { wordMinuteEight, wordNone },                //  8
-  { wordMinuteNine, wordNone },                 //  9
-  { wordMinuteTen, wordNone },                  // 10
-  { wordMinuteEleven, wordNone },               // 11
-  { wordMinuteTwelve, wordNone },               // 12
-  { wordSoon, wordQuarter, wordNone },          // nearly Quarter
-  { wordSoon, wordQuarter, wordNone },          // nearly Quarter
-  { wordQuarter, wordNone },                    // 15, Quarter
-  { wordMinuteSix, wordMinuteTen, wordNone },   // 16
-  { wordMinuteSeven, wordMinuteTen, wordNone }, // 17
-  { wordSoon, wordMinuteTwenty, wordNone },     // 18
-  { wordSoon, wordMinuteTwenty, wordNone },     // 19
-  { wordMinuteTwenty, wordNone },               // 20
-  { wordMinuteTwentyOne, wordNone },            // 21
-  { wordMinuteTwentyTwo, wordNone },            // 22
-  { wordSoon, wordMinuteFive, wordNone },       // 23
-  { wordSoon, wordMinuteFive, wordNone },       // 24
-  { wordMinuteFive, wordNone },                 // 25
-  { wordMinuteFour, wordNone },                 // 26
-  { wordMinuteThree, wordNone },                // 27
-  { wordMinuteTwo, wordNone },                  // 28
-  { wordMinuteOne, wordNone },                  // 29
-  { wordNone },                                 // 30
-  { wordMinuteOne, wordNone },                  // 31
-  { wordMinuteTwo, wordNone },                  // 32
-  { wordMinuteThree, wordNone },                // 33
-  { wordMinuteFour, wordNone },                 // 34
-  { wordMinuteFive, wordNone },                 // 35
-  { wordMinuteFive, wordNone },                 // 36
-  { wordMinuteFive, wordNone },                 // 37
-  { wordSoon, wordMinuteTwenty, wordNone },     // 38
-  { wordSoon, wordMinuteTwenty, wordNone },     // 39
-  { wordMinuteTwenty, wordNone },               // 40
-  { wordMinuteTwenty, wordNone },               // 41
-  { wordMinuteTwenty, wordNone },               // 42
-  { wordSoon, wordQuarter, wordNone },          // 43
-  { wordSoon, wordQuarter, wordNone },          // 44
-  { wordQuarter, wordNone },                    // 45
-  { wordQuarter, wordNone },                    // 46
-  { wordQuarter, wordNone },                    // 47
-  { wordMinuteTwelve, wordNone },               // 48
-  { wordMinuteEleven, wordNone },               // 49
-  { wordMinuteTen, wordNone },                  // 50
-  { wordMinuteNine, wordNone },                 // 51
-  { wordMinuteEight, wordNone },                // 52
-  { wordMinuteSeven, wordNone },                // 53
-  { wordMinuteSix, wordNone },                  // 54
-  { wordMinuteFive, wordNone },                 // 55
-  { wordMinuteFour, wordNone },                 // 56
-  { wordMinuteThree, wordNone },                // 57
-  { wordMinuteTwo, wordNone },                  // 58
-  { wordMinuteOne, wordNone }                   // 59
-};
-
-/*  Matrix for the clock face. 
-*   Matches the clock face character string
-*   Every second line is in reverse
-*   (LED string meanders)
-* 
-*      012345678901
-*   0--aS.ISCH.####---11
-*  23--BALD.VIERTEL---12
-*  24--ZWEISFuFACHT---35
-*  47--DRuELF.ZWoLF---36
-*  48--SaCHSIEBaZaH---59
-*  71--NuNaZWANZIG.---60
-*  72--HALBI#VOR.AB---83
-*  95--ZWoLFI.ACHTI---84
-*  96--DRuFuFiZaHNI--107 
-* 119--ZWEIS.VIERI.--108
-* 120--SaCHSIEBNI.#--131
-* 143--ELFINuNI.GSI--132
-*      012345678901  */
-
-// all 12 word hours
-static int wordHourOne[] = { 117, 116, 115, -1 };
-static int wordHourTwo[] = { 119, 118, 117, 116, -1 };
-static int wordHourThree[] = { 96, 97, 98, -1 };
-static int wordHourFour[] = { 113, 112, 111, 110, 109, -1 };
-static int wordHourFive[] = { 99, 100, 101, 102, -1 };
-static int wordHourSix[] = { 120, 121, 122, 123, 124, 125, -1 };
-static int wordHourSeven[] = { 124, 125, 126, 127, 128, 129, -1 };
-static int wordHourEight[] = { 88, 87, 86, 85, 84, -1 };
-static int wordHourNine[] = { 139, 138, 137, 136, -1 };
-static int wordHourTen[] = { 103, 104, 105, 106, 107, -1 };
-static int wordHourEleven[] = { 143, 142, 141, 140, -1 };
-static int wordHourTwelve[] = { 95, 94, 93, 92, 91, 90, -1 };
+static unsigned long Dark =   Adafruit_NeoPixel::Color(GAMMA(1*BRIGHTNESS/8), GAMMA(1*BRIGHTNESS/8), GAMMA(1*BRIGHTNESS/8));
+static unsigned long Grey =   Adafruit_NeoPixel::Color(GAMMA(4*BRIGHTNESS/8), GAMMA(4*BRIGHTNESS/8), GAMMA(4*BRIGHTNESS/8));
+static unsigned long Silver = Adafruit_NeoPixel::Color(GAMMA(6*BRIGHTNESS/8), GAMMA(6*BRIGHTNESS/8), GAMMA(6*BRIGHTNESS/8));
+static unsigned long White =  Adafruit_NeoPixel::Color(GAMMA(BRIGHTNESS), GAMMA(BRIGHTNESS), GAMMA(BRIGHTNESS));
 
-// assemble 12+1 hours
-static int* wordHours[] = { wordHourTwelve, wordHourOne, wordHourTwo,
-                            wordHourThree, wordHourFour, wordHourFive,
-                            wordHourSix, wordHourSeven, wordHourEight,
-                            wordHourNine, wordHourTen, wordHourEleven,
-                            wordHourTwelve };
+static unsigned long Red =    Adafruit_NeoPixel::Color(GAMMA(BRIGHTNESS), 0, 0);
+static unsigned long Orange = Adafruit_NeoPixel::Color(GAMMA(BRIGHTNESS), GAMMA(BRIGHTNESS/2), 0);
+static unsigned long Yellow = Adafruit_NeoPixel::Color(GAMMA(BRIGHTNESS), GAMMA(BRIGHTNESS), 0);
+static unsigned long Green =  Adafruit_NeoPixel::Color(0, GAMMA(BRIGHTNESS), 0);
+static unsigned long Blue =   Adafruit_NeoPixel::Color(0, 0, GAMMA(BRIGHTNESS));
+static unsigned long Cyan =   Adafruit_NeoPixel::Color(0, GAMMA(BRIGHTNESS), GAMMA(BRIGHTNESS));
+static unsigned long Magenta = Adafruit_NeoPixel::Color(GAMMA(BRIGHTNESS), 0, GAMMA(BRIGHTNESS));
 
 #endif
\ No newline at end of file
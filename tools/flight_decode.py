@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+Decode a WordClock flight recorder dump.
+
+Send 'd' to the clock on the Serial port, save everything it prints to a file,
+then:
+
+    python3 tools/flight_decode.py serial.log
+
+Every "FR <hex>" line is one 32 byte record (see FlightRecorder.h). Frames are
+replayed from their keyframe/delta masks and drawn as the 12x12 face, lit
+letters taken from wordClockString in FaceLayout.h, unlit ones as '.'.
+"""
+
+import datetime
+import os
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IIHBB20s")
+BOOT, KEYFRAME, FRAME, WIFI, NTP, WATCHDOG, NOTE = range(1, 8)
+ROWS, COLS = 12, 12
+
+RESET_REASONS = {
+    0: "unknown", 1: "power-on", 2: "external", 3: "software", 4: "panic",
+    5: "interrupt watchdog", 6: "task watchdog", 7: "other watchdog",
+    8: "deep sleep", 9: "brownout", 10: "SDIO",
+}
+WIFI_STATUS = {
+    0: "idle", 1: "no SSID", 2: "scan completed", 3: "connected",
+    4: "connect failed", 5: "connection lost", 6: "disconnected", 255: "no shield",
+}
+
+
+def face_string():
+    """wordClockString from FaceLayout.h, strip order (meandering)."""
+    header = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "FaceLayout.h")
+    with open(header, encoding="utf-8", errors="replace") as f:
+        m = re.search(r'wordClockString\[\]\s*=\s*"([^"]*)"', f.read())
+    return m.group(1)
+
+
+def strip_index(row, col):
+    """FaceGeometry<12, 12, FACE_TOP_LEFT, FACE_ALONG_ROWS>"""
+    return row * COLS + (COLS - 1 - col if row & 1 else col)
+
+
+def draw(mask, letters):
+    lines = []
+    for row in range(ROWS):
+        line = ""
+        for col in range(COLS):
+            p = strip_index(row, col)
+            lit = (mask >> p) & 1
+            line += letters[p].upper() if lit else "."
+        lines.append("    " + line)
+    return "\n".join(lines)
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit(__doc__)
+    letters = face_string()
+    frame = None
+    with open(sys.argv[1], errors="replace") as f:
+        for line in f:
+            m = re.match(r"FR ([0-9a-f]{64})\s*$", line.strip())
+            if not m:
+                continue
+            seq, utc, ms, kind, _, data = RECORD.unpack(bytes.fromhex(m.group(1)))
+            when = datetime.datetime.fromtimestamp(utc, datetime.timezone.utc)
+            stamp = "%8d %s.%03d UTC" % (seq, when.strftime("%Y-%m-%d %H:%M:%S"), ms)
+            mask = int.from_bytes(data[:18], "little")
+            if kind == BOOT:
+                frame = None
+                version = data[1:].split(b"\0")[0].decode(errors="replace")
+                print("%s boot (%s), firmware %s" % (stamp, RESET_REASONS.get(data[0], data[0]), version))
+            elif kind == KEYFRAME or (kind == FRAME and frame is not None):
+                frame = mask if kind == KEYFRAME else frame ^ mask
+                print("%s frame%s" % (stamp, " (key)" if kind == KEYFRAME else ""))
+                print(draw(frame, letters))
+            elif kind == FRAME:
+                print("%s frame (no keyframe yet, skipped)" % stamp)
+            elif kind == WIFI:
+                rssi = struct.unpack("<b", data[1:2])[0]
+                print("%s wifi %s, %d dBm" % (stamp, WIFI_STATUS.get(data[0], data[0]), rssi))
+            elif kind == NTP:
+                offset, delay = struct.unpack("<ii", data[:8])
+                print("%s ntp offset %+d ms, round trip %d ms" % (stamp, offset, delay))
+            elif kind == WATCHDOG:
+                print("%s watchdog near miss, loop() took %d ms" % (stamp, struct.unpack("<I", data[:4])[0]))
+            elif kind == NOTE:
+                print("%s note: %s" % (stamp, data.split(b"\0")[0].decode(errors="replace")))
+            else:
+                print("%s unknown record type %d" % (stamp, kind))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""
+Turn a recorded light log into the TIME_WARP light trace (AMBIENT_LIGHT, AmbientLight.h).
+
+Build with AMBIENT_LIGHT (and not TIME_WARP), send 'L' to the clock on the Serial
+port and keep everything it prints for a day or more; every minute it prints
+
+    light 06:31 412
+
+(local time, the raw reading in the sensor's units). Then:
+
+    python3 tools/light_trace.py light.log -o AmbientLightTrace.h
+
+averages the readings per --step minutes of the day over all the days in the log
+(gaps are filled in along a straight line from the neighbours) and writes the
+header AmbientLight.cpp replays in TIME_WARP. Several logs can go in at once.
+"""
+
+import argparse
+import re
+import sys
+
+LINE = re.compile(r"^light (\d\d):(\d\d) (\d+)\s*$")
+
+
+def read(paths):
+    samples = []
+    for path in paths:
+        with open(path, encoding="utf-8", errors="replace") as f:
+            for line in f:
+                m = LINE.match(line.strip())
+                if m:
+                    samples.append((int(m.group(1)) * 60 + int(m.group(2)), int(m.group(3))))
+    return samples
+
+
+def trace(samples, step):
+    n = 1440 // step
+    sums = [0] * n
+    counts = [0] * n
+    for minute, reading in samples:
+        sums[minute // step] += reading
+        counts[minute // step] += 1
+    points = [sums[i] // counts[i] if counts[i] else None for i in range(n)]
+    known = [i for i in range(n) if points[i] is not None]
+    # gaps: straight lines between the nearest bins either side, round midnight
+    for i in range(n):
+        if points[i] is None:
+            before = max((k for k in known if k < i), default=known[-1] - n)
+            after = min((k for k in known if k > i), default=known[0] + n)
+            a, b = points[before % n], points[after % n]
+            points[i] = a + (b - a) * (i - before) // (after - before)
+    return points, n - len(known)
+
+
+def header(points, step, sources, samples, filled):
+    out = [
+        "#ifndef AMBIENT_LIGHT_TRACE_H",
+        "#define AMBIENT_LIGHT_TRACE_H",
+        "",
+        "// made by tools/light_trace.py from %s: %d samples, about %.1f days,"
+        % (", ".join(sources), samples, samples / 1440.0),
+        "// %d of %d points filled in; see AmbientLight.h" % (filled, len(points)),
+        "",
+        "#define LIGHT_TRACE_STEP %d  // s between points, from midnight local time" % (step * 60),
+        "",
+        "static const uint16_t lightTrace[%d] = {" % len(points),
+    ]
+    for i in range(0, len(points), 12):
+        minute = i * step
+        out.append(" %s  // %02d:%02d" % ("".join("%5d," % min(v, 65535) for v in points[i:i + 12]),
+                                        minute // 60, minute % 60))
+    out += ["};", "", "#endif"]
+    return "\n".join(out) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="+", help="Serial output with 'L' on")
+    parser.add_argument("--step", type=int, default=15, help="minutes per trace point, a divisor of 1440")
+    parser.add_argument("-o", "--output", help="header to write, stdout if not given")
+    args = parser.parse_args()
+    if args.step < 1 or 1440 % args.step:
+        parser.error("--step must divide a day (1440 minutes)")
+
+    samples = read(args.log)
+    if not samples:
+        sys.exit("no 'light HH:MM reading' lines in %s" % ", ".join(args.log))
+    points, filled = trace(samples, args.step)
+    text = header(points, args.step, args.log, len(samples), filled)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text)
+        print("%d samples, %d points (%d filled in) -> %s" % (len(samples), len(points), filled, args.output))
+    else:
+        sys.stdout.write(text)
+
+
+if __name__ == "__main__":
+    main()
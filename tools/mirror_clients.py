@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""
+Viewers for the clock's face mirror (FACE_MIRROR, FaceMirror.h), to measure what
+the WebSocket costs on the wire with several of them watching.
+
+    python3 tools/mirror_clients.py 192.168.1.50 --clients 4 --slow 1 --seconds 120
+
+opens --clients WebSockets on ws://<clock>:<port>/ws, --slow of them reading only
+every --slow-delay ms (so their send queues on the clock fill up and they get
+coalesced deltas), and prints per client the frames by type, payload bytes, and
+everything that came in over TCP (handshake and WebSocket headers included).
+A rainbow or chase on the clock (Serial, or MQTT effect) makes for lots of frames;
+compare with Serial 'w' on the clock.
+"""
+
+import argparse
+import base64
+import hashlib
+import os
+import socket
+import threading
+import time
+
+GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+TYPES = ("full", "delta", "frame")
+
+
+class Viewer(threading.Thread):
+    def __init__(self, n, args, slow):
+        super().__init__(daemon=True)
+        self.n = n
+        self.args = args
+        self.slow = slow
+        self.frames = [0, 0, 0]
+        self.payload = [0, 0, 0]
+        self.wire = 0
+        self.pixels = 0
+        self.pings = 0
+        self.error = None
+
+    def recv(self, sock, n):
+        """n bytes; socket.timeout only gets out before the first of them, so nothing
+        read so far is dropped."""
+        data = b""
+        while len(data) < n:
+            try:
+                chunk = sock.recv(n - len(data))
+            except socket.timeout:
+                if not data:
+                    raise
+                continue
+            if not chunk:
+                raise ConnectionError("closed by the clock")
+            data += chunk
+        self.wire += len(data)
+        return data
+
+    def run(self):
+        try:
+            self.watch()
+        except (OSError, ConnectionError) as e:
+            self.error = str(e)
+
+    def watch(self):
+        sock = socket.create_connection((self.args.host, self.args.port), timeout=10)
+        if self.slow:
+            # a small receive window, so the clock feels it
+            sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 1024)
+        key = base64.b64encode(os.urandom(16))
+        sock.sendall(b"GET /ws HTTP/1.1\r\nHost: %s\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                     b"Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n"
+                     % (self.args.host.encode(), key))
+        head = b""
+        while not head.endswith(b"\r\n\r\n"):
+            head += self.recv(sock, 1)
+        expect = base64.b64encode(hashlib.sha1(key + GUID).digest())
+        if b" 101 " not in head.split(b"\r\n")[0] or expect not in head:
+            raise ConnectionError("bad handshake: %r" % head)
+        end = time.time() + self.args.seconds
+        sock.settimeout(1)
+        while time.time() < end:
+            try:
+                b0, b1 = self.recv(sock, 2)
+            except socket.timeout:
+                continue
+            sock.settimeout(None)
+            length = b1 & 0x7F
+            if length == 126:
+                length = int.from_bytes(self.recv(sock, 2), "big")
+            payload = self.recv(sock, length)
+            sock.settimeout(1)
+            if b0 & 0x0F == 0x09:
+                # the clock closes viewers that don't answer its pings, as a browser does
+                sock.sendall(bytes([0x8A, 0x80 | length, 0, 0, 0, 0]) + payload)
+                self.pings += 1
+                continue
+            kind = payload[0]
+            if kind == 0:
+                self.pixels = (len(payload) - 2) // 4
+            self.frames[kind] += 1
+            self.payload[kind] += len(payload)
+            if self.slow:
+                time.sleep(self.args.slow_delay / 1000.0)
+        # close frame, masked as the spec wants from a client
+        sock.sendall(bytes([0x88, 0x80, 0, 0, 0, 0]))
+        sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--clients", type=int, default=4)
+    parser.add_argument("--slow", type=int, default=0, help="how many of them are slow readers")
+    parser.add_argument("--slow-delay", type=int, default=500, help="ms a slow reader waits between frames")
+    parser.add_argument("--seconds", type=float, default=60)
+    args = parser.parse_args()
+
+    viewers = [Viewer(i, args, i < args.slow) for i in range(args.clients)]
+    for v in viewers:
+        v.start()
+        time.sleep(0.05)
+    for v in viewers:
+        v.join()
+
+    for v in viewers:
+        frames = sum(v.frames)
+        payload = sum(v.payload)
+        detail = ", ".join("%s %d/%dB" % (t, f, b) for t, f, b in zip(TYPES, v.frames, v.payload))
+        print("viewer %d%s: %s, %d pings" % (v.n, " (slow)" if v.slow else "", detail, v.pings))
+        if frames:
+            print("  %d frames, %.1f payload bytes/frame, %d bytes on the wire (%.1f%% overhead)"
+                  % (frames, payload / frames, v.wire, 100.0 * (v.wire - payload) / max(payload, 1)))
+            if v.pixels:
+                print("  a raw RGB frame would be %d bytes" % (3 * v.pixels))
+        if v.error:
+            print("  error: %s" % v.error)
+
+
+if __name__ == "__main__":
+    main()
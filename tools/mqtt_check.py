@@ -0,0 +1,274 @@
+#!/usr/bin/env python3
+"""
+Check the clock's MQTT state against a broker (MQTT_STATE, MQTTState.h).
+
+    python3 tools/mqtt_check.py 192.168.1.10 --topic wordclock/WORDCLOCK --minutes 5
+
+talks MQTT 3.1.1 to the broker itself (no paho needed) and goes through:
+
+  retained    subscribing to <topic>/state gets the last state, retained
+  phrase      set/effect "phrase exact", so the phrase changes every minute
+  brightness  set/brightness (one off what the clock has): exactly one state,
+              within --react s, with the new brightness
+  flips       for --minutes minutes from the next one: exactly one state per
+              minute flip, each with a new phrase
+  restore     brightness back, set/effect "phrase <--phrase-after>"
+  retained    a fresh subscription gets the last state seen, retained
+
+Run it with the laptop on NTP too: a state is put down to the minute the laptop
+says it arrived in, give or take 30 s. Prints each state as it comes in and one
+line per check, exits 1 if any failed.
+"""
+
+import argparse
+import json
+import socket
+import struct
+import sys
+import time
+
+KEYS = ("phrase", "level", "brightness", "offset_ms", "rssi", "holiday")
+
+
+class MQTT:
+    """Just enough MQTT 3.1.1: connect, subscribe and publish at QoS 0, ping."""
+
+    def __init__(self, host, port, client_id, keepalive=60):
+        self.sock = socket.create_connection((host, port), timeout=10)
+        self.buf = b""
+        self.pending = []  # packets that came in while we waited for a SUBACK
+        self.keepalive = keepalive
+        self.last_sent = time.time()
+        body = self._string(b"MQTT") + bytes([4, 0x02]) + struct.pack("!H", keepalive) + self._string(client_id.encode())
+        self._send(0x10, body)  # CONNECT, clean session
+        kind, body = self._packet(10)
+        if kind is None or kind & 0xF0 != 0x20 or len(body) < 2 or body[1] != 0:
+            raise ConnectionError("broker refused the connection: %r" % body)
+
+    @staticmethod
+    def _string(s):
+        return struct.pack("!H", len(s)) + s
+
+    def _send(self, head, body):
+        length = len(body)
+        encoded = b""
+        while True:
+            byte = length % 128
+            length //= 128
+            encoded += bytes([byte | (0x80 if length else 0)])
+            if not length:
+                break
+        self.sock.sendall(bytes([head]) + encoded + body)
+        self.last_sent = time.time()
+
+    def _read(self, n, timeout):
+        end = time.time() + timeout
+        while len(self.buf) < n:
+            left = end - time.time()
+            if left <= 0:
+                return None
+            self.sock.settimeout(left)
+            try:
+                chunk = self.sock.recv(4096)
+            except socket.timeout:
+                return None
+            if not chunk:
+                raise ConnectionError("broker closed the connection")
+            self.buf += chunk
+        data, self.buf = self.buf[:n], self.buf[n:]
+        return data
+
+    def _packet(self, timeout):
+        """(first byte, body) of the next packet, (None, None) if there's none in time;
+        once its first byte is in, the rest is waited for"""
+        head = self._read(1, timeout)
+        if head is None:
+            return None, None
+        length, shift = 0, 0
+        while True:
+            byte = self._read(1, 10)[0]
+            length |= (byte & 0x7F) << shift
+            shift += 7
+            if not byte & 0x80:
+                break
+        return head[0], self._read(length, 10) if length else b""
+
+    def subscribe(self, topic):
+        self._send(0x82, struct.pack("!H", 1) + self._string(topic.encode()) + bytes([0]))
+        while True:
+            kind, body = self._packet(10)
+            if kind is None:
+                raise ConnectionError("no SUBACK for %s" % topic)
+            if kind & 0xF0 == 0x90:
+                return
+            self.pending.append((kind, body))
+
+    def publish(self, topic, payload):
+        self._send(0x30, self._string(topic.encode()) + payload.encode())
+
+    def message(self, timeout):
+        """(topic, payload, retained) of the next PUBLISH, None if none came in time"""
+        end = time.time() + timeout
+        while True:
+            left = end - time.time()
+            if left <= 0:
+                return None
+            if time.time() - self.last_sent > self.keepalive / 2:
+                self._send(0xC0, b"")  # PINGREQ
+            if self.pending:
+                kind, body = self.pending.pop(0)
+            else:
+                kind, body = self._packet(min(left, self.keepalive / 2))
+            if kind is None or kind & 0xF0 != 0x30:
+                continue  # PINGRESP, or nothing yet
+            n = struct.unpack("!H", body[:2])[0]
+            topic = body[2:2 + n].decode()
+            offset = 2 + n + (2 if kind & 0x06 else 0)  # packet id from QoS 1/2
+            return topic, body[offset:].decode("utf-8", errors="replace"), bool(kind & 0x01)
+
+    def close(self):
+        self._send(0xE0, b"")  # DISCONNECT
+        self.sock.close()
+
+
+class Check:
+    def __init__(self, args):
+        self.args = args
+        self.failed = 0
+        self.last = None  # the last state payload seen
+        self._sent = 0    # when the last command went out
+
+    def result(self, name, ok, detail):
+        print("%-10s %s  %s" % (name, "ok  " if ok else "FAIL", detail))
+        if not ok:
+            self.failed += 1
+
+    def state(self, client, timeout):
+        """the next state (as a dict, with its arrival time), skipping status messages"""
+        end = time.time() + timeout
+        while time.time() < end:
+            m = client.message(end - time.time())
+            if m is None:
+                return None
+            topic, payload, retained = m
+            if topic != self.args.topic + "/state":
+                print("           %s %s" % (topic, payload))
+                continue
+            print("           %s %s%s" % (time.strftime("%H:%M:%S"), payload, " (retained)" if retained else ""))
+            try:
+                state = json.loads(payload)
+            except ValueError:
+                state = {}
+            state["_at"] = time.time()
+            state["_retained"] = retained
+            state["_payload"] = payload
+            self.last = payload
+            return state
+        return None
+
+    def retained(self, name):
+        client = MQTT(self.args.host, self.args.port, "mqtt_check_%d" % int(time.time()))
+        client.subscribe(self.args.topic + "/state")
+        s = self.state(client, self.args.react)
+        client.close()
+        if s is None:
+            self.result(name, False, "no retained state on %s/state" % self.args.topic)
+            return None
+        missing = [k for k in KEYS if k not in s]
+        ok = s["_retained"] and not missing
+        self.result(name, ok, "retained flag %s%s" % (s["_retained"], ", missing " + ", ".join(missing) if missing else ""))
+        return s
+
+    def quiet(self, client, seconds):
+        """states that come in within seconds (there shouldn't be any)"""
+        n = 0
+        while self.state(client, seconds) is not None:
+            n += 1
+        return n
+
+    def run(self):
+        a = self.args
+        first = self.retained("retained")
+        if first is None:
+            return
+        client = MQTT(a.host, a.port, "mqtt_check")
+        client.subscribe(a.topic + "/state")
+        client.subscribe(a.topic + "/status")
+        self.state(client, 2)  # the retained one again, not counted
+
+        # commands between flips, so their repaint has the minute to itself
+        self._midMinute(client)
+        client.publish(a.topic + "/set/effect", "phrase exact")
+        self.quiet(client, a.react)  # a repaint, if the mode was something else
+        brightness = first.get("brightness", 128)
+        target = brightness - 1 if brightness > 1 else brightness + 1
+        self._midMinute(client)
+        client.publish(a.topic + "/set/brightness", str(target))
+        s = self.state(client, a.react)
+        extra = self.quiet(client, a.react)
+        self.result("brightness", s is not None and s.get("brightness") == target and extra == 0,
+                    "%d -> %s in %s, %d more" % (brightness, s.get("brightness") if s else "-",
+                                                  "%.1f s" % (s["_at"] - self._sent) if s else "-", extra))
+
+        # one state per minute flip, each with a new phrase; a state counts for
+        # the minute it's nearest to, so from 30 s before the first flip
+        first_flip = int(time.time() / 60) + 1
+        end = (first_flip + a.minutes) * 60 - 30
+        counts = {}
+        phrases = []
+        while time.time() < end:
+            s = self.state(client, end - time.time())
+            if s is None:
+                break
+            minute = int((s["_at"] + 30) // 60)
+            if minute < first_flip:
+                continue
+            counts[minute] = counts.get(minute, 0) + 1
+            phrases.append(s.get("phrase"))
+        flips = range(first_flip, first_flip + a.minutes)
+        missing = sum(1 for m in flips if counts.get(m, 0) == 0)
+        doubles = sum(counts.get(m, 0) - 1 for m in flips if counts.get(m, 0) > 1)
+        same = sum(1 for p, q in zip(phrases, phrases[1:]) if p == q)
+        self.result("flips", missing == 0 and doubles == 0 and same == 0,
+                    "%d minutes, %d states, %d without one, %d too many, %d repeated a phrase"
+                    % (a.minutes, sum(counts.values()), missing, doubles, same))
+
+        self._midMinute(client)
+        client.publish(a.topic + "/set/brightness", str(brightness))
+        client.publish(a.topic + "/set/effect", "phrase " + a.phrase_after)
+        self.quiet(client, a.react)
+        client.close()
+        print("restore    brightness %d, phrase %s" % (brightness, a.phrase_after))
+
+        last = self.last
+        s = self.retained("retained")
+        if s is not None:
+            self.result("last", s["_payload"] == last, "the retained state is the last one seen")
+
+    def _midMinute(self, client):
+        """wait for the quiet middle of a minute, 15..45 s past, taking what comes in"""
+        while not 15 <= time.time() % 60 <= 45:
+            self.state(client, 0.5)
+        self._sent = time.time()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("host", help="the broker MQTT_BROKER_URL points at")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--topic", default="wordclock/WORDCLOCK", help="MQTT_TOPIC, wordclock/<HOSTNAME>")
+    parser.add_argument("--minutes", type=int, default=5, help="minute flips to watch")
+    parser.add_argument("--react", type=float, default=3, help="s a command has to show in the state")
+    parser.add_argument("--phrase-after", default="semi", help="phrase mode to leave the clock in")
+    args = parser.parse_args()
+
+    check = Check(args)
+    try:
+        check.run()
+    except (OSError, ConnectionError) as e:
+        sys.exit("broker: %s" % e)
+    sys.exit(1 if check.failed else 0)
+
+
+if __name__ == "__main__":
+    main()
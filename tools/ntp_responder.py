@@ -0,0 +1,97 @@
+#!/usr/bin/env python3
+"""
+A small NTP server to test the clock's SNTP client against.
+
+    python3 tools/ntp_responder.py --port 12300 --delay 40 --skew -250
+
+then put this machine's IP into NTP_SERVERS and the port into NTP_PORT
+(WordClock.h). Replies carry the laptop's clock, shifted by --skew ms.
+
+--delay ms (plus up to --jitter ms, random) is the network: half of it before the
+request is stamped as received, half after the reply is stamped as transmitted,
+so it is in the round trip the clock measures and the server's own time (t3 - t2)
+stays ~0. --out and --back add that many ms to one leg only: an asymmetric path,
+which shifts the offset by half the difference and no client can see. --hold
+waits between the receive and transmit stamps instead, a busy server, which the
+delay formula takes out again.
+
+--drop loses that fraction of requests, --zero answers with all-zero timestamps
+(a broken server, the client has to ignore it).
+"""
+
+import argparse
+import random
+import socket
+import struct
+import threading
+import time
+
+NTP_UNIX_OFFSET = 2208988800
+PACKET = struct.Struct("!BBbbII4sQQQQ")
+
+
+def to_ntp(t):
+    sec = int(t) + NTP_UNIX_OFFSET
+    frac = int((t - int(t)) * (1 << 32))
+    return ((sec & 0xFFFFFFFF) << 32) | (frac & 0xFFFFFFFF)
+
+
+def clock(args):
+    return time.time() + args.skew / 1000.0
+
+
+def reply(sock, addr, request, args):
+    # request on its way here
+    network = args.delay + random.uniform(0, args.jitter)
+    time.sleep((network / 2 + args.out) / 1000.0)
+    received = clock(args)
+    time.sleep(args.hold / 1000.0)
+    transmit = clock(args)
+    version = (request[0] >> 3) & 0x07
+    originate = PACKET.unpack(request[:PACKET.size])[10]
+    if args.zero:
+        rx, tx = 0, 0
+    else:
+        rx, tx = to_ntp(received), to_ntp(transmit)
+    packet = PACKET.pack(
+        (0 << 6) | (version << 3) | 4,  # LI 0, client's version, mode 4 (server)
+        args.stratum, 6, -20,           # stratum, poll, precision (~1 us)
+        0, 0, b"LOCL",                  # root delay, root dispersion, reference id
+        rx,                             # reference timestamp
+        originate,                      # originate = the client's transmit timestamp
+        rx, tx)
+    # reply on its way back
+    time.sleep((network / 2 + args.back) / 1000.0)
+    sock.sendto(packet, addr)
+    print("%s:%d  rx %.6f  tx %.6f" % (addr[0], addr[1], received, transmit))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=12300, help="UDP port (123 needs root)")
+    parser.add_argument("--delay", type=float, default=0, help="ms round trip on the network, half each way")
+    parser.add_argument("--jitter", type=float, default=0, help="up to this many ms more, random")
+    parser.add_argument("--out", type=float, default=0, help="ms more on the way to the server")
+    parser.add_argument("--back", type=float, default=0, help="ms more on the way back")
+    parser.add_argument("--hold", type=float, default=0, help="ms between receive and transmit stamps")
+    parser.add_argument("--skew", type=float, default=0, help="ms added to our clock in replies")
+    parser.add_argument("--drop", type=float, default=0, help="fraction of requests to ignore, 0..1")
+    parser.add_argument("--zero", action="store_true", help="reply with zero timestamps")
+    parser.add_argument("--stratum", type=int, default=2, help="0 is a kiss-o'-death")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", args.port))
+    print("NTP responder on port %d" % args.port)
+    while True:
+        request, addr = sock.recvfrom(512)
+        if len(request) < PACKET.size or (request[0] & 0x07) != 3:
+            continue
+        if random.random() < args.drop:
+            print("%s:%d  dropped" % addr)
+            continue
+        threading.Thread(target=reply, args=(sock, addr, request, args), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,44 @@
+#!/usr/bin/env python3
+"""
+Write the signed OTA manifest for a firmware image (OTA_UPDATE, OTAUpdate.h).
+
+    python3 tools/ota_sign.py ota_key.pem 2024.11.01 wordclock.bin > wordclock.txt
+
+prints the one line the clock fetches from OTA_MANIFEST_URL:
+
+    <version> <sha256 of the image, hex> <ECDSA P-256 signature, DER, hex>
+
+The signature is over "<version> <sha256>", made with the private key in ota_key.pem
+(openssl does the signing, so nothing beyond it is needed); the clock checks it with
+OTA_PUBLIC_KEY before it looks at the version or fetches the image. Make the key
+pair as OTAUpdate.h says, and keep the private half away from the clock and git.
+"""
+
+import argparse
+import hashlib
+import re
+import subprocess
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("key", help="the private key, PEM (openssl ecparam -name prime256v1 -genkey)")
+    parser.add_argument("version", help="FIRMWARE_VERSION of the image, e.g. 2024.11.01")
+    parser.add_argument("image", help="the .bin, as exported by the IDE")
+    args = parser.parse_args()
+    if not re.match(r"^\d+(\.\d+)*$", args.version) or len(args.version) >= 32:
+        parser.error("the version is numbers and dots, the clock compares them that way")
+
+    with open(args.image, "rb") as f:
+        sha = hashlib.sha256(f.read()).hexdigest()
+    signed = ("%s %s" % (args.version, sha)).encode()
+    result = subprocess.run(["openssl", "dgst", "-sha256", "-sign", args.key],
+                            input=signed, stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+    if result.returncode != 0:
+        sys.exit("openssl: %s" % result.stderr.decode(errors="replace").strip())
+    print("%s %s" % (signed.decode(), result.stdout.hex()))
+
+
+if __name__ == "__main__":
+    main()
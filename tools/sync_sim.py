@@ -0,0 +1,230 @@
+#!/usr/bin/env python3
+"""
+Loopback simulation of LAN sync (LAN_SYNC, ClockSync.h), to measure how far apart
+several clocks flip their faces.
+
+    python3 tools/sync_sim.py --clocks 4 --error 400 --drift 40 --delay 3 --jitter 20 --seconds 60
+
+runs --clocks instances of the ClockSync protocol on 127.0.0.1, one UDP port each
+from --port (the multicast group becomes a send to every other port). Packets are
+ClockSync::Packet byte for byte, and the announce/election/delay exchange and the
+fastest-of-SYNC_SAMPLES offset follow ClockSync.cpp, so a change there wants the
+same change here.
+
+Every clock has its own time base: the host clock, off by up to --error ms (its own
+NTP result) and running --drift ppm fast or slow. Every packet is held back --delay
+ms plus up to --jitter ms, random (WiFi), and leader -> follower another --asym ms
+(an asymmetric path, which no exchange can see).
+
+Like WordClock::loop(), every clock sleeps until its next whole second and notes
+the host time it woke up at. The flip spread of a second is the latest minus the
+earliest of those wakeups; after --settle s (the first offsets applied) the median,
+95th percentile and worst spread are printed, with every clock's offset to the
+leader at the end.
+"""
+
+import argparse
+import random
+import select
+import socket
+import struct
+import threading
+import time
+
+# ClockSync.h
+MAGIC = 0x57434C4B
+ANNOUNCE, DELAY_REQ, DELAY_RESP = 1, 2, 3
+ANNOUNCE_INTERVAL = 2000
+REQUEST_INTERVAL = 500
+PEER_TIMEOUT = 10000
+SAMPLES = 8
+MAX_RTT = 100
+PACKET = struct.Struct("<IBBHIiiqqq")  # packed, little endian like the ESP32
+
+
+def now_ms():
+    return time.time() * 1000.0
+
+
+def half(x):
+    """C's x / 2 on integers, towards zero."""
+    return -((-x) // 2) if x < 0 else x // 2
+
+
+class Clock(threading.Thread):
+    def __init__(self, n, args, peers):
+        super().__init__(daemon=True)
+        self.n = n
+        self.args = args
+        self.peers = peers
+        self.node = 0x100000 + n          # lowest leads, like the MAC part
+        self.start_ms = now_ms()
+        self.error = 0 if n == 0 else random.uniform(-args.error, args.error)
+        self.drift = random.uniform(-args.drift, args.drift) * 1e-6
+        self.offset = int(self.error)     # TimeBase::_offset_ms, on top of the skewed host clock
+        self.lock = threading.Lock()
+        self.leader = 0
+        self.leader_port = None
+        self.leader_heard = 0
+        self.last_announce = -ANNOUNCE_INTERVAL
+        self.last_request = 0
+        self.samples = []
+        self.last_offset = 0
+        self.last_rtt = 0
+        self.flips = {}                   # second -> host ms of the wakeup
+        self.sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self.sock.bind(("127.0.0.1", args.port + n))
+        self.sock.setblocking(False)
+
+    # TimeBase
+    def uptime_ms(self):
+        return int(now_ms() - self.start_ms)
+
+    def utc_ms(self):
+        host = now_ms()
+        with self.lock:
+            return int(host + (host - self.start_ms) * self.drift) + self.offset
+
+    def is_leader(self):
+        return self.leader == 0 or self.node < self.leader
+
+    def is_following(self):
+        return not self.is_leader() and self.leader != 0
+
+    def send(self, fields, port):
+        data = PACKET.pack(*fields)
+        delay = self.args.delay + random.uniform(0, self.args.jitter)
+        if fields[1] == DELAY_RESP:
+            delay += self.args.asym
+        threading.Timer(delay / 1000.0, self.sock.sendto, (data, ("127.0.0.1", port))).start()
+
+    def run(self):
+        threading.Thread(target=self.flipper, daemon=True).start()
+        while True:
+            self.poll(ANNOUNCE_INTERVAL)
+
+    # ClockSync::_poll(): select() until a packet or the next announce or request
+    def poll(self, wait_ms):
+        now = self.uptime_ms()
+        due = self.last_announce + ANNOUNCE_INTERVAL
+        if self.is_following():
+            due = min(due, self.last_request + REQUEST_INTERVAL)
+        wait_ms = max(0, min(wait_ms, due - now))
+        if select.select([self.sock], [], [], wait_ms / 1000.0)[0]:
+            while True:
+                try:
+                    data, addr = self.sock.recvfrom(512)
+                except BlockingIOError:
+                    break
+                if len(data) == PACKET.size:
+                    p = list(PACKET.unpack(data))
+                    if p[0] == MAGIC and p[4] != self.node:
+                        self.receive(p, addr[1])
+        now = self.uptime_ms()
+        if self.leader != 0 and now - self.leader_heard > PEER_TIMEOUT:
+            self.leader = 0
+            self.samples = []
+        if now - self.last_announce >= ANNOUNCE_INTERVAL:
+            for port in self.peers:
+                if port != self.args.port + self.n:
+                    self.send((MAGIC, ANNOUNCE, 1, 0, self.node, self.last_offset, self.last_rtt,
+                               self.utc_ms(), 0, 0), port)
+            self.last_announce = now
+        if self.is_following() and now - self.last_request >= REQUEST_INTERVAL:
+            self.send((MAGIC, DELAY_REQ, 1, 0, self.node, 0, 0, self.utc_ms(), 0, 0), self.leader_port)
+            self.last_request = now
+
+    # ClockSync::_receive()
+    def receive(self, p, port):
+        kind, time_set, node, t1, t2, t3 = p[1], p[2], p[4], p[7], p[8], p[9]
+        if kind == ANNOUNCE:
+            if time_set and (self.leader == 0 or node <= self.leader):
+                if node != self.leader:
+                    self.samples = []
+                self.leader = node
+                self.leader_port = port
+                self.leader_heard = self.uptime_ms()
+        elif kind == DELAY_REQ:
+            if self.is_leader():
+                t = self.utc_ms()
+                self.send((MAGIC, DELAY_RESP, 1, 0, self.node, 0, 0, t1, t, t), port)
+        elif kind == DELAY_RESP:
+            t4 = self.utc_ms()
+            rtt = (t4 - t1) - (t3 - t2)
+            if node == self.leader and 0 <= rtt <= MAX_RTT and len(self.samples) < SAMPLES:
+                self.samples.append((half((t2 - t1) + (t3 - t4)), rtt))
+                if len(self.samples) == SAMPLES:
+                    self.apply_best()
+
+    # ClockSync::_applyBestSample(), step or adjust are the same thing here
+    def apply_best(self):
+        offset, rtt = min(self.samples, key=lambda s: s[1])
+        with self.lock:
+            self.offset += offset
+        self.last_offset = offset
+        self.last_rtt = rtt
+        self.samples = []
+
+    # WordClock::loop(): sleep until the next whole second, that's when the face flips
+    def flipper(self):
+        while True:
+            time.sleep((1000 - self.utc_ms() % 1000) / 1000.0)
+            woke = now_ms()
+            self.flips[int(round(self.utc_ms() / 1000.0))] = woke
+
+
+def percentile(values, p):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(p * len(values)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--clocks", type=int, default=4)
+    parser.add_argument("--port", type=int, default=14412, help="first UDP port, one per clock")
+    parser.add_argument("--error", type=float, default=400, help="ms, followers' clocks start up to this far off")
+    parser.add_argument("--drift", type=float, default=40, help="ppm, up to this fast or slow")
+    parser.add_argument("--delay", type=float, default=3, help="ms every packet takes")
+    parser.add_argument("--jitter", type=float, default=20, help="up to this many ms more, random")
+    parser.add_argument("--asym", type=float, default=0, help="ms more from leader to follower")
+    parser.add_argument("--settle", type=float, default=15, help="s before the spread counts")
+    parser.add_argument("--seconds", type=float, default=60, help="s of spread to measure")
+    parser.add_argument("--seed", type=int, default=None)
+    args = parser.parse_args()
+    random.seed(args.seed)
+
+    peers = [args.port + i for i in range(args.clocks)]
+    clocks = [Clock(i, args, peers) for i in range(args.clocks)]
+    for c in clocks:
+        print("clock %d: node %X, starts %+.0f ms off, %+.1f ppm"
+              % (c.n, c.node, c.error, c.drift * 1e6))
+    first = int(now_ms() / 1000)
+    for c in clocks:
+        c.start()
+    time.sleep(args.settle + args.seconds + 2)
+
+    def spreads(lo, hi):
+        out = []
+        for s in range(lo, hi):
+            woke = [c.flips[s] for c in clocks if s in c.flips]
+            if len(woke) == len(clocks):
+                out.append(max(woke) - min(woke))
+        return out
+
+    before = spreads(first + 1, first + 4)
+    after = spreads(first + int(args.settle), first + int(args.settle + args.seconds))
+    if before:
+        print("flip spread before sync: %.1f ms" % max(before))
+    if not after:
+        print("no complete seconds to measure")
+        return
+    print("flip spread over %d s: median %.1f ms, 95%% %.1f ms, worst %.1f ms"
+          % (len(after), percentile(after, 0.5), percentile(after, 0.95), max(after)))
+    leader = clocks[0].utc_ms()
+    for c in clocks[1:]:
+        print("clock %d: %+d ms to the leader, last offset %+d ms at rtt %d ms"
+              % (c.n, c.utc_ms() - leader, c.last_offset, c.last_rtt))
+
+
+if __name__ == "__main__":
+    main()
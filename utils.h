@@ -8,6 +8,18 @@
   #define WIFI_PASS "YOUR PASS"
   #define HOSTNAME  "WORDCLOCK"
 
+  // OTA firmware updates, see OTAUpdate.h
+  #define OTA_MANIFEST_URL "http://192.168.1.10:8000/wordclock.txt"
+  #define OTA_FIRMWARE_URL "http://192.168.1.10:8000/wordclock.bin"
+  // the public half of your signing key (openssl ec -pubout), PEM, manifests must be signed with it
+  #define OTA_PUBLIC_KEY \
+    "-----BEGIN PUBLIC KEY-----\n" \
+    "YOUR KEY\n" \
+    "-----END PUBLIC KEY-----\n"
+
+  // home automation, see MQTTState.h
+  #define MQTT_BROKER_URL "mqtt://192.168.1.10:1883"
+
 #endif
 
 /* 